@@ -0,0 +1,201 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "epd_color.h"
+
+static const char *TAG = "epd_color";
+
+EPD_ColorMap g_color_table[EPD_PALETTE_SIZE] = {
+    {   0,   0,   0,  EPD_4IN0E_BLACK },  // Black
+    { 255, 255, 255,  EPD_4IN0E_WHITE },  // White
+    { 255, 255,   0,  EPD_4IN0E_YELLOW},  // Yellow
+    { 255,   0,   0,  EPD_4IN0E_RED   },  // Red
+    {   0,   0, 255,  EPD_4IN0E_BLUE  },  // Blue
+    {   0, 255,   0,  EPD_4IN0E_GREEN },  // Green
+    // 다른 색상(Gray 등)을 추가하면 EPD_PALETTE_SIZE도 늘린다
+};
+const int g_color_count = sizeof(g_color_table) / sizeof(g_color_table[0]);
+
+uint8_t g_epd_color_lut[EPD_LUT_CELLS / 2];
+static bool s_lut_ready = false;
+
+// 4비트 인덱스 -> 팔레트 RGB (오차 계산용)
+static uint8_t s_idx_rgb[16][3];
+
+// 4x4 Bayer 행렬 (0~15)
+static const uint8_t s_bayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+uint8_t get_nearest_epd_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    // 알파가 매우 작으면 -> 흰색(또는 배경) 처리
+    if (a < EPD_ALPHA_THRESHOLD) {
+        return EPD_4IN0E_WHITE;
+    }
+
+    int best_dist = 99999999;
+    uint8_t best_idx = EPD_4IN0E_WHITE; // 기본값 White
+    for (int i = 0; i < g_color_count; i++) {
+        int dr = (int)r - (int)g_color_table[i].r;
+        int dg = (int)g - (int)g_color_table[i].g;
+        int db = (int)b - (int)g_color_table[i].b;
+        int dist = (dr * dr) + (dg * dg) + (db * db);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best_idx = g_color_table[i].idx4;
+        }
+    }
+    return best_idx;
+}
+
+void epd_color_lut_init(void)
+{
+    if (s_lut_ready) {
+        return;
+    }
+
+    const int levels = 1 << EPD_LUT_BITS;
+    uint32_t cell = 0;
+    for (int qr = 0; qr < levels; qr++) {
+        for (int qg = 0; qg < levels; qg++) {
+            for (int qb = 0; qb < levels; qb++, cell++) {
+                uint8_t idx = get_nearest_epd_color(epd_lut_level(qr), epd_lut_level(qg),
+                                                    epd_lut_level(qb), 0xff);
+                if (cell & 1) {
+                    g_epd_color_lut[cell >> 1] |= idx & 0x0F;
+                } else {
+                    g_epd_color_lut[cell >> 1] = idx << 4;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < g_color_count; i++) {
+        s_idx_rgb[g_color_table[i].idx4][0] = g_color_table[i].r;
+        s_idx_rgb[g_color_table[i].idx4][1] = g_color_table[i].g;
+        s_idx_rgb[g_color_table[i].idx4][2] = g_color_table[i].b;
+    }
+    s_lut_ready = true;
+    ESP_LOGI(TAG, "palette LUT ready (%d cells, %d bytes)", EPD_LUT_CELLS, (int)sizeof(g_epd_color_lut));
+}
+
+static inline uint8_t clamp_u8(int v)
+{
+    return (v < 0) ? 0 : (v > 255) ? 255 : (uint8_t)v;
+}
+
+const char *epd_dither_mode_name(epd_dither_mode_t mode)
+{
+    switch (mode) {
+    case EPD_DITHER_ORDERED:         return "bayer";
+    case EPD_DITHER_FLOYD_STEINBERG: return "floyd-steinberg";
+    default:                         return "none";
+    }
+}
+
+bool epd_dither_init(epd_dither_t *d, epd_dither_mode_t mode, int width)
+{
+    memset(d, 0, sizeof(*d));
+    d->mode = mode;
+    d->width = width;
+    if (mode != EPD_DITHER_FLOYD_STEINBERG) {
+        return true;
+    }
+
+    // 양 끝 경계를 위해 좌우 1픽셀씩 여유
+    size_t n = (size_t)(width + 2) * 3;
+    d->err_cur  = (int16_t *)calloc(n, sizeof(int16_t));
+    d->err_next = (int16_t *)calloc(n, sizeof(int16_t));
+    if (!d->err_cur || !d->err_next) {
+        ESP_LOGE(TAG, "Failed to allocate dither error rows");
+        epd_dither_free(d);
+        return false;
+    }
+    return true;
+}
+
+void epd_dither_free(epd_dither_t *d)
+{
+    free(d->err_cur);
+    free(d->err_next);
+    d->err_cur = NULL;
+    d->err_next = NULL;
+}
+
+static void dither_row_fs(epd_dither_t *d, const uint8_t *rgba, uint8_t *out)
+{
+    int16_t *cur = d->err_cur + 3;    // cur[-3..-1], cur[width*3..] 는 경계 여유분
+    int16_t *next = d->err_next + 3;
+
+    for (int x = 0; x < d->width; x++) {
+        const uint8_t *px = rgba + x * 4;
+        if (px[3] < EPD_ALPHA_THRESHOLD) {
+            // 투명 픽셀은 흰색 배경, 오차를 퍼뜨리지 않음
+            out[x] = EPD_4IN0E_WHITE;
+            continue;
+        }
+
+        int16_t *e = cur + x * 3;
+        uint8_t r = clamp_u8(px[0] + e[0] / 16);
+        uint8_t g = clamp_u8(px[1] + e[1] / 16);
+        uint8_t b = clamp_u8(px[2] + e[2] / 16);
+        uint8_t idx = epd_color_lut_rgb(r, g, b);
+        out[x] = idx;
+
+        int er = (int)r - s_idx_rgb[idx][0];
+        int eg = (int)g - s_idx_rgb[idx][1];
+        int eb = (int)b - s_idx_rgb[idx][2];
+
+        //          *   7
+        //      3   5   1     (/16)
+        int16_t *right = e + 3;
+        int16_t *below = next + x * 3;
+        right[0] += er * 7;     right[1] += eg * 7;     right[2] += eb * 7;
+        below[-3] += er * 3;    below[-2] += eg * 3;    below[-1] += eb * 3;
+        below[0] += er * 5;     below[1] += eg * 5;     below[2] += eb * 5;
+        below[3] += er;         below[4] += eg;         below[5] += eb;
+    }
+
+    // 다음 행으로: 버퍼 교환 후 새 next 비움
+    int16_t *tmp = d->err_cur;
+    d->err_cur = d->err_next;
+    d->err_next = tmp;
+    memset(d->err_next, 0, (size_t)(d->width + 2) * 3 * sizeof(int16_t));
+}
+
+void epd_dither_row(epd_dither_t *d, const uint8_t *rgba, int y, uint8_t *out)
+{
+    switch (d->mode) {
+    case EPD_DITHER_FLOYD_STEINBERG:
+        dither_row_fs(d, rgba, out);
+        break;
+
+    case EPD_DITHER_ORDERED: {
+        // 임계값 -> 채널 오프셋 약 -120 ~ +120 (팔레트 색 간격 255 기준)
+        const uint8_t *bayer = s_bayer4[y & 3];
+        for (int x = 0; x < d->width; x++) {
+            const uint8_t *px = rgba + x * 4;
+            if (px[3] < EPD_ALPHA_THRESHOLD) {
+                out[x] = EPD_4IN0E_WHITE;
+                continue;
+            }
+            int offset = ((bayer[x & 3] * 2 + 1) * 255) / 32 - 128;
+            out[x] = epd_color_lut_rgb(clamp_u8(px[0] + offset),
+                                       clamp_u8(px[1] + offset),
+                                       clamp_u8(px[2] + offset));
+        }
+        break;
+    }
+
+    default:
+        for (int x = 0; x < d->width; x++) {
+            const uint8_t *px = rgba + x * 4;
+            out[x] = epd_color_lut(px[0], px[1], px[2], px[3]);
+        }
+        break;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * epd_color.h
+ *
+ * E Ink Spectra 6 (E6) 팔레트와 RGB -> 4비트 인덱스 컬러 변환 (4.0"/7.3" 패널 공통)
+ *
+ * get_nearest_epd_color()는 팔레트 6색에 대한 거리 계산(기준 구현)이고,
+ * epd_color_lut()은 부팅 시 한 번 만든 RGB 5-5-5 큐브 테이블을 한 번 읽어 변환한다.
+ * 두 결과는 팔레트 경계가 지나가는 칸에서만 다르다 (전체 RGB의 약 1%,
+ * tools/epd_color_lut_test.c에서 24비트 전체를 비교).
+ */
+#ifndef __EPD_COLOR_H
+#define __EPD_COLOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EPD_4IN0E_BLACK   0x0   /// 000
+#define EPD_4IN0E_WHITE   0x1   /// 001
+#define EPD_4IN0E_YELLOW  0x2   /// 010
+#define EPD_4IN0E_RED     0x3   /// 011
+#define EPD_4IN0E_BLUE    0x5   /// 101
+#define EPD_4IN0E_GREEN   0x6   /// 110
+
+// 알파가 이 값보다 작으면 흰색(배경)으로 처리
+#define EPD_ALPHA_THRESHOLD 10
+
+typedef struct {
+    uint8_t r, g, b;  // 8비트 RGB
+    uint8_t idx4;     // e-Paper 4비트 컬러 인덱스
+} EPD_ColorMap;
+
+#define EPD_PALETTE_SIZE  6
+
+extern EPD_ColorMap g_color_table[EPD_PALETTE_SIZE];
+extern const int g_color_count;
+
+// RGB 큐브 테이블: 채널당 상위 5비트 -> 32x32x32 칸, 칸당 4비트 인덱스 (2칸 = 1바이트)
+#define EPD_LUT_BITS   5
+#define EPD_LUT_SHIFT  (8 - EPD_LUT_BITS)
+#define EPD_LUT_CELLS  (1 << (3 * EPD_LUT_BITS))
+
+extern uint8_t g_epd_color_lut[EPD_LUT_CELLS / 2];
+
+uint8_t get_nearest_epd_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+// g_color_table로부터 테이블 생성 (여러 번 불러도 한 번만 만든다)
+void epd_color_lut_init(void);
+
+// 칸의 대표값: 5비트 값을 8비트로 확장 (0 -> 0, 31 -> 255)
+static inline uint8_t epd_lut_level(uint8_t q)
+{
+    return (uint8_t)((q << EPD_LUT_SHIFT) | (q >> (2 * EPD_LUT_BITS - 8)));
+}
+
+static inline uint8_t epd_color_lut_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+    uint32_t cell = ((uint32_t)(r >> EPD_LUT_SHIFT) << (2 * EPD_LUT_BITS))
+                  | ((uint32_t)(g >> EPD_LUT_SHIFT) << EPD_LUT_BITS)
+                  | (uint32_t)(b >> EPD_LUT_SHIFT);
+    uint8_t v = g_epd_color_lut[cell >> 1];
+    return (cell & 1) ? (v & 0x0F) : (v >> 4);
+}
+
+static inline uint8_t epd_color_lut(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (a < EPD_ALPHA_THRESHOLD) {
+        return EPD_4IN0E_WHITE;
+    }
+    return epd_color_lut_rgb(r, g, b);
+}
+
+/*
+ * 디더링 (행 단위 스트리밍)
+ *
+ * EPD_DITHER_NONE            : 가장 가까운 색 (LUT)
+ * EPD_DITHER_ORDERED         : 4x4 Bayer 행렬 - 상태 없음, 가장 가벼움
+ * EPD_DITHER_FLOYD_STEINBERG : 오차 확산 - 현재/다음 행 두 줄의 int16 오차 버퍼만 사용
+ */
+typedef enum {
+    EPD_DITHER_NONE = 0,
+    EPD_DITHER_ORDERED,
+    EPD_DITHER_FLOYD_STEINBERG,
+} epd_dither_mode_t;
+
+typedef struct {
+    epd_dither_mode_t mode;
+    int width;
+    int16_t *err_cur;   // (width + 2) * 3 채널, 1/16 단위 누적 오차
+    int16_t *err_next;
+} epd_dither_t;
+
+const char *epd_dither_mode_name(epd_dither_mode_t mode);
+
+bool epd_dither_init(epd_dither_t *d, epd_dither_mode_t mode, int width);
+void epd_dither_free(epd_dither_t *d);
+
+// RGBA 한 행(원본 y번째)을 픽셀당 4비트 인덱스 out[width]로 변환
+// 행은 위에서부터 순서대로 넣어야 한다.
+void epd_dither_row(epd_dither_t *d, const uint8_t *rgba, int y, uint8_t *out);
+
+#endif
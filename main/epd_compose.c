@@ -0,0 +1,88 @@
+#include <string.h>
+#include "epd_compose.h"
+
+#define CLAMP(v, lo, hi)  ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+void epd_compose_init(epd_compose_t *c, const uint8_t *image, int img_w, int img_h,
+                      int x, int y, int panel_w, int panel_h, uint8_t bg_color)
+{
+    c->image = image;
+    c->src_stride = (img_w + 1) / 2;
+    c->stride = (panel_w + 1) / 2;
+    c->x = x;
+    c->y = y;
+    c->px0 = CLAMP(x, 0, panel_w);
+    c->px1 = CLAMP(x + img_w, c->px0, panel_w);
+    c->y0 = CLAMP(y, 0, panel_h);
+    c->y1 = CLAMP(y + img_h, c->y0, panel_h);
+    c->f0 = (c->px0 + 1) / 2;
+    c->f1 = c->px1 / 2;
+    if (c->f1 < c->f0) {
+        c->f1 = c->f0;
+    }
+    c->bg = (uint8_t)((bg_color << 4) | (bg_color & 0x0f));
+}
+
+// 창 안이면 이미지 니블, 밖이면 배경 니블
+static inline uint8_t compose_pixel(const epd_compose_t *c, const uint8_t *src, int px)
+{
+    if (px < c->px0 || px >= c->px1) {
+        return c->bg & 0x0f;
+    }
+    int k = px - c->x;
+    return (k & 1) ? (src[k / 2] & 0x0f) : (src[k / 2] >> 4);
+}
+
+// 창 경계에 반만 걸친 바이트
+static inline uint8_t compose_edge(const epd_compose_t *c, const uint8_t *src, int j)
+{
+    return (uint8_t)((compose_pixel(c, src, 2 * j) << 4) | compose_pixel(c, src, 2 * j + 1));
+}
+
+void epd_compose_row(const epd_compose_t *c, uint8_t *dst, int row, int col, int end)
+{
+    if (row < c->y0 || row >= c->y1 || c->px0 == c->px1) {
+        memset(dst, c->bg, end - col);
+        return;
+    }
+
+    const uint8_t *src = c->image + (size_t)(row - c->y) * c->src_stride;
+    int a = CLAMP(c->f0, col, end);
+    int b = CLAMP(c->f1, col, end);
+
+    memset(dst, c->bg, a - col);
+    if (c->x & 1) {
+        // 이미지 픽셀 k = 2j - x 는 홀수: src[k/2]의 아래 니블 + src[k/2 + 1]의 위 니블
+        const uint8_t *s = src + (2 * a - c->x) / 2;
+        for (int j = a; j < b; j++, s++) {
+            dst[j - col] = (uint8_t)((s[0] << 4) | (s[1] >> 4));
+        }
+    } else {
+        memcpy(dst + (a - col), src + (2 * a - c->x) / 2, b - a);
+    }
+    memset(dst + (b - col), c->bg, end - b);
+
+    // 반만 걸친 양 끝 바이트
+    if ((c->px0 & 1) && c->f0 - 1 >= col && c->f0 - 1 < end) {
+        dst[c->f0 - 1 - col] = compose_edge(c, src, c->f0 - 1);
+    }
+    if ((c->px1 & 1) && c->f1 >= col && c->f1 < end) {
+        dst[c->f1 - col] = compose_edge(c, src, c->f1);
+    }
+}
+
+size_t epd_compose_fill(const epd_compose_t *c, uint8_t *dst, size_t offset, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        int row = (offset + done) / c->stride;
+        int col = (offset + done) % c->stride;
+        size_t n = c->stride - col;
+        if (n > len - done) {
+            n = len - done;
+        }
+        epd_compose_row(c, dst + done, row, col, col + (int)n);
+        done += n;
+    }
+    return len;
+}
@@ -0,0 +1,40 @@
+/*
+ * epd_compose.h
+ *
+ * 4bpp 패널 프레임 위에 사각형 이미지를 합성 (창 갱신, 오버레이)
+ *
+ * 창의 잘린 범위는 초기화 때 한 번 계산하고, 행마다 왼쪽 배경 memset, 이미지 구간
+ * memcpy, 오른쪽 배경 memset으로 채운다. 창의 x가 홀수면 패널 바이트와 이미지 바이트의
+ * 니블 위치가 어긋나므로 구간 안은 니블을 한 칸씩 밀어서 복사하고, 창 양 끝에서 반만
+ * 걸친 바이트는 배경 니블과 합친다.
+ *
+ * 이미지 한 행은 (width + 1) / 2 바이트 (GUI_Paint와 같은 배치).
+ * ESP-IDF 의존성이 없어서 호스트에서도 빌드된다 (tools/epd_compose_bench.c).
+ */
+#ifndef __EPD_COMPOSE_H
+#define __EPD_COMPOSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const uint8_t *image;
+    size_t src_stride;      // 이미지 한 행 바이트 수
+    size_t stride;          // 패널 한 행 바이트 수
+    int x, y;               // 창 왼쪽 위 (픽셀, 잘리기 전)
+    int px0, px1;           // 패널 안으로 자른 창의 픽셀 열 범위 [px0, px1)
+    int y0, y1;             // 패널 안으로 자른 창의 행 범위 [y0, y1)
+    int f0, f1;             // 두 픽셀 모두 창 안인 바이트 열 범위 [f0, f1)
+    uint8_t bg;             // 배경 (두 픽셀)
+} epd_compose_t;
+
+void epd_compose_init(epd_compose_t *c, const uint8_t *image, int img_w, int img_h,
+                      int x, int y, int panel_w, int panel_h, uint8_t bg_color);
+
+// 패널 row 행의 바이트 열 [col, end)를 dst에 채운다
+void epd_compose_row(const epd_compose_t *c, uint8_t *dst, int row, int col, int end);
+
+// 프레임의 바이트 위치 offset부터 len 바이트를 채운다 (DMA 링 청크용)
+size_t epd_compose_fill(const epd_compose_t *c, uint8_t *dst, size_t offset, size_t len);
+
+#endif
@@ -0,0 +1,123 @@
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "epd_frame.h"
+
+static const char *TAG = "epd_frame";
+
+uint32_t epd_fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool epd_frame_path(char *out, size_t out_len, const char *png_path)
+{
+    const char *ext = strrchr(png_path, '.');
+    size_t base_len = ext ? (size_t)(ext - png_path) : strlen(png_path);
+    if (base_len + sizeof(EPD_FRAME_EXT) > out_len) {
+        return false;
+    }
+    memcpy(out, png_path, base_len);
+    memcpy(out + base_len, EPD_FRAME_EXT, sizeof(EPD_FRAME_EXT));
+    return true;
+}
+
+void epd_frame_header_init(epd_frame_header_t *hdr, uint16_t width, uint16_t height,
+                           uint32_t data_size, const struct stat *src_st, uint8_t dither)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, EPD_FRAME_MAGIC, sizeof(hdr->magic));
+    hdr->version = EPD_FRAME_VERSION;
+    hdr->header_size = sizeof(epd_frame_header_t);
+    hdr->dither = dither;
+    hdr->width = width;
+    hdr->height = height;
+    hdr->data_size = data_size;
+    hdr->src_size = (uint32_t)src_st->st_size;
+    hdr->src_mtime = (uint32_t)src_st->st_mtime;
+}
+
+bool epd_frame_write(const char *frame_path, const epd_frame_header_t *hdr, const uint8_t *data)
+{
+    char tmp_path[256];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", frame_path) >= (int)sizeof(tmp_path)) {
+        ESP_LOGE(TAG, "Frame path too long: %s", frame_path);
+        return false;
+    }
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to create frame: %s", tmp_path);
+        return false;
+    }
+
+    bool ok = fwrite(hdr, 1, sizeof(*hdr), fp) == sizeof(*hdr)
+           && fwrite(data, 1, hdr->data_size, fp) == hdr->data_size;
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write frame: %s", tmp_path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    // FAT에서는 기존 파일 위로 rename이 안 되므로 먼저 지운다
+    unlink(frame_path);
+    if (rename(tmp_path, frame_path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename frame: %s", frame_path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Frame cached: %s (%u bytes, hash %08lx)", frame_path,
+             (unsigned)hdr->data_size, (unsigned long)hdr->src_hash);
+    return true;
+}
+
+FILE *epd_frame_open(const char *frame_path, const epd_frame_header_t *expect, epd_frame_header_t *out_hdr)
+{
+    FILE *fp = fopen(frame_path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    epd_frame_header_t hdr;
+    if (fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+        || memcmp(hdr.magic, EPD_FRAME_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.version != EPD_FRAME_VERSION
+        || hdr.header_size != sizeof(epd_frame_header_t)) {
+        ESP_LOGW(TAG, "Invalid frame header: %s", frame_path);
+        fclose(fp);
+        return NULL;
+    }
+
+    if (hdr.width != expect->width || hdr.height != expect->height
+        || hdr.data_size != expect->data_size
+        || hdr.src_size != expect->src_size || hdr.src_mtime != expect->src_mtime
+        || hdr.dither != expect->dither
+        || (expect->src_hash != 0 && hdr.src_hash != expect->src_hash)) {
+        ESP_LOGI(TAG, "Stale frame: %s", frame_path);
+        fclose(fp);
+        return NULL;
+    }
+
+    // 쓰다가 끊긴 파일은 패널을 켜기 전에 걸러낸다
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0
+        || (uint64_t)st.st_size != (uint64_t)hdr.header_size + hdr.data_size) {
+        ESP_LOGW(TAG, "Truncated frame: %s", frame_path);
+        fclose(fp);
+        return NULL;
+    }
+
+    if (out_hdr) {
+        *out_hdr = hdr;
+    }
+    return fp;
+}
@@ -0,0 +1,60 @@
+/*
+ * epd_frame.h
+ *
+ * SD 카드에 캐시하는 패널 전용 프레임(.epd) 형식
+ *
+ *   [epd_frame_header_t 32바이트][4비트 패널 프레임 data_size 바이트]
+ *
+ * 프레임은 이미 패널 방향으로 회전/디더링/팩킹된 상태라서
+ * 표시할 때 libpng, zlib, RGBA 버퍼 없이 파일을 그대로 패널로 흘려보낸다.
+ * 원본 PNG의 크기/수정 시각/디더링 방식이 헤더와 다르면 캐시를 무효로 본다.
+ * FAT 수정 시각은 2초 단위라서, 인덱스가 원본 해시를 알면 해시도 맞아야 유효하다.
+ */
+#ifndef __EPD_FRAME_H
+#define __EPD_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define EPD_FRAME_MAGIC    "EPD6"
+#define EPD_FRAME_VERSION  1
+#define EPD_FRAME_EXT      ".epd"
+
+#define EPD_FNV1A_INIT     2166136261u
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];      // "EPD6"
+    uint8_t  version;
+    uint8_t  header_size;   // sizeof(epd_frame_header_t)
+    uint8_t  rotate;        // 원본 PNG 방향 (0 / 90)
+    uint8_t  dither;        // epd_dither_mode_t
+    uint16_t width;         // 패널 가로 픽셀
+    uint16_t height;        // 패널 세로 픽셀
+    uint32_t data_size;     // 프레임 바이트 수 (width/2 * height)
+    uint32_t src_size;      // 원본 PNG 크기
+    uint32_t src_mtime;     // 원본 PNG 수정 시각
+    uint32_t src_hash;      // 원본 PNG FNV-1a 32 (업로드 때 받으면서 계산, 모르면 0)
+    uint32_t reserved;
+} epd_frame_header_t;
+
+// FNV-1a 32비트 누적 해시
+uint32_t epd_fnv1a(uint32_t hash, const void *data, size_t len);
+
+// "/sdcard/a.png" -> "/sdcard/a.epd"
+bool epd_frame_path(char *out, size_t out_len, const char *png_path);
+
+// 원본 정보로 헤더 기본값 채우기 (rotate, src_hash는 변환 후 채움)
+void epd_frame_header_init(epd_frame_header_t *hdr, uint16_t width, uint16_t height,
+                           uint32_t data_size, const struct stat *src_st, uint8_t dither);
+
+// 헤더 + 프레임 저장 (임시 파일에 쓴 뒤 이름 변경)
+bool epd_frame_write(const char *frame_path, const epd_frame_header_t *hdr, const uint8_t *data);
+
+// 캐시 프레임 열기: expect와 크기/원본 정보/디더링이 일치하고 파일 길이가 헤더 + data_size이면
+// 데이터 시작 위치에 놓인 FILE 반환. expect->src_hash가 0이 아니면 원본 해시도 같아야 한다.
+FILE *epd_frame_open(const char *frame_path, const epd_frame_header_t *expect, epd_frame_header_t *out_hdr);
+
+#endif
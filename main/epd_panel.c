@@ -0,0 +1,81 @@
+#include "esp_attr.h"
+#include "epd_panel.h"
+
+// 명령 표는 SPI 전송 버퍼로 바로 쓰이므로 DMA가 읽을 수 있는 내부 RAM에 둔다
+#if CONFIG_EPD_PANEL_7IN3E
+
+// 7.3inch e-Paper (E), 800x480
+DRAM_ATTR static const lcd_init_cmd_t epd_init_cmds[] = {
+    {0xAA, {0x49, 0x55, 0x20, 0x08, 0x09, 0x18}, 6},
+    {0x01, {0x3f}, 1},
+    {0x00, {0x5f, 0x69}, 2},
+    {0x03, {0x00, 0x54, 0x00, 0x44}, 4},
+    {0x05, {0x40, 0x1f, 0x1f, 0x2c}, 4},
+    {0x06, {0x6f, 0x1f, 0x17, 0x49}, 4},
+    {0x08, {0x6f, 0x1f, 0x1f, 0x22}, 4},
+    {0x30, {0x03}, 1},
+    {0x50, {0x3f}, 1},
+    {0x60, {0x02, 0x00}, 2},
+    {0x61, {0x03, 0x20, 0x01, 0xe0}, 4},
+    {0x84, {0x01}, 1},
+    {0xe3, {0x2f}, 1},
+    {0, {0}, 0xff},
+};
+
+DRAM_ATTR const epd_panel_t epd_panel = {
+    .name = "7.3inch Spectra 6 (E)",
+    .width = EPD_PANEL_WIDTH,
+    .height = EPD_PANEL_HEIGHT,
+    .bpp = EPD_PANEL_BPP,
+    .palette = g_color_table,
+    .palette_count = EPD_PALETTE_SIZE,
+    .init_cmds = epd_init_cmds,
+    .frame_cmd = 0x10,
+    .power_on_cmd = 0x04,
+    .booster = {0x06, {0x6f, 0x1f, 0x17, 0x49}, 4},
+    .refresh = {0x12, {0x00}, 1},
+    .power_off = {0x02, {0x00}, 1},
+    .deep_sleep = {0x07, {0xa5}, 1},
+    .reset_settle_ms = 30,
+    .power_settle_ms = CONFIG_EPD_POWER_SETTLE_MS,
+};
+
+#else
+
+// 4inch e-Paper (E), 400x600
+DRAM_ATTR static const lcd_init_cmd_t epd_init_cmds[] = {
+    {0xAA, {0x49, 0x55, 0x20, 0x08, 0x09, 0x18}, 6},
+    {0x01, {0x3f}, 1},
+    {0x00, {0x5f, 0x69}, 2},
+    {0x05, {0x40, 0x1f, 0x1f, 0x2c}, 4},
+    {0x08, {0x6f, 0x1f, 0x1f, 0x22}, 4},
+    {0x06, {0x6f, 0x1f, 0x17, 0x17}, 4},
+    {0x03, {0x00, 0x54, 0x00, 0x44}, 4},
+    {0x60, {0x02, 0x00}, 2},
+    {0x30, {0x08}, 1},
+    {0x50, {0x3f}, 1},
+    {0x61, {0x01, 0x90, 0x02, 0x58}, 4},
+    {0xe3, {0x2f}, 1},
+    {0x84, {0x01}, 1},
+    {0, {0}, 0xff},
+};
+
+DRAM_ATTR const epd_panel_t epd_panel = {
+    .name = "4inch Spectra 6 (E)",
+    .width = EPD_PANEL_WIDTH,
+    .height = EPD_PANEL_HEIGHT,
+    .bpp = EPD_PANEL_BPP,
+    .palette = g_color_table,
+    .palette_count = EPD_PALETTE_SIZE,
+    .init_cmds = epd_init_cmds,
+    .frame_cmd = 0x10,
+    .power_on_cmd = 0x04,
+    .booster = {0x06, {0x6f, 0x1f, 0x17, 0x27}, 4},
+    .refresh = {0x12, {0x00}, 1},
+    .power_off = {0x02, {0x00}, 1},
+    .deep_sleep = {0x07, {0x00}, 1},
+    .reset_settle_ms = 30,
+    .power_settle_ms = CONFIG_EPD_POWER_SETTLE_MS,
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * epd_panel.h
+ *
+ * 패널 기술자: 크기, 픽셀 비트 수, 팔레트, 초기화 명령 표, 갱신 명령과 대기 시간
+ *
+ * 패널은 menuconfig에서 컴파일 시 하나를 고른다 (CONFIG_EPD_PANEL_*). 크기와 행/프레임
+ * 바이트 수는 매크로 상수라서 변환/팩킹/합성 루프는 패널마다 상수 크기로 컴파일되고,
+ * 명령 표와 대기 시간처럼 한 번씩만 쓰는 값은 epd_panel 구조체에서 읽는다.
+ *
+ * 지원: 4.0" Spectra 6 (400x600), 7.3" Spectra 6 (800x480). 둘 다 컨트롤러 하나에
+ * 같은 6색 팔레트(epd_color.h)를 쓴다. 13.3" Spectra 6는 컨트롤러가 둘(CS 두 개로
+ * 좌/우 절반)이라 전송 경로가 달라서 아직 없다.
+ */
+#ifndef __EPD_PANEL_H
+#define __EPD_PANEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "epd_color.h"
+
+#if CONFIG_EPD_PANEL_7IN3E
+#define EPD_PANEL_WIDTH       800
+#define EPD_PANEL_HEIGHT      480
+#else
+#define EPD_PANEL_WIDTH       400
+#define EPD_PANEL_HEIGHT      600
+#endif
+
+#define EPD_PANEL_BPP         4
+// 한 행 바이트 수 (2픽셀 = 1바이트, 홀수 폭이면 마지막 바이트의 아래 니블은 흰색)
+#define EPD_PANEL_STRIDE      ((EPD_PANEL_WIDTH * EPD_PANEL_BPP + 7) / 8)
+#define EPD_PANEL_FRAME_SIZE  ((size_t)EPD_PANEL_STRIDE * EPD_PANEL_HEIGHT)
+// 긴 변 (회전된 원본 한 행의 최대 픽셀 수)
+#define EPD_PANEL_MAX_SIDE    (EPD_PANEL_WIDTH > EPD_PANEL_HEIGHT ? EPD_PANEL_WIDTH : EPD_PANEL_HEIGHT)
+
+typedef struct {
+    uint8_t cmd;
+    uint8_t data[16];
+    uint8_t databytes; //No of data in data; bit 7 = delay after set; 0xFF = end of cmds.
+} lcd_init_cmd_t;
+
+typedef struct {
+    const char *name;
+    uint16_t width, height;
+    uint8_t bpp;
+    const EPD_ColorMap *palette;
+    int palette_count;
+    const lcd_init_cmd_t *init_cmds;    // databytes 0xFF로 끝남
+    uint8_t frame_cmd;                  // 프레임 데이터 시작 (DTM)
+    uint8_t power_on_cmd;
+    lcd_init_cmd_t booster;             // 갱신 직전 부스터 재설정
+    lcd_init_cmd_t refresh;
+    lcd_init_cmd_t power_off;
+    lcd_init_cmd_t deep_sleep;
+    uint16_t reset_settle_ms;           // 리셋 후 초기화 명령까지
+    uint16_t power_settle_ms;           // 전원 켜기/부스터 설정 후
+} epd_panel_t;
+
+extern const epd_panel_t epd_panel;
+
+#endif
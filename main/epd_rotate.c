@@ -0,0 +1,61 @@
+#include <string.h>
+#include "epd_rotate.h"
+
+void epd_rotate_init(epd_rotate_t *r, uint8_t *frame, int panel_w, int panel_h,
+                     uint8_t *strip, int strip_rows)
+{
+    r->frame = frame;
+    r->stride = (panel_w + 1) / 2;
+    r->panel_w = panel_w;
+    r->panel_h = panel_h;
+    r->strip = strip;
+    r->strip_rows = strip_rows;
+    r->first = 0;
+}
+
+// 띠의 원본 행 [first, first + rows)를 패널 열로 내보낸다.
+// 원본 열 c -> 패널 행 (panel_h - 1 - c). 띠마다 위->아래, 아래->위를 번갈아 써서
+// 앞 띠가 마지막에 건드린 캐시 줄(다음 띠와 같은 줄이 많다)부터 다시 쓴다.
+static void epd_rotate_flush(epd_rotate_t *r, int rows)
+{
+    const size_t half = r->strip_rows / 2;
+    const size_t n = (rows + 1) / 2;
+    uint8_t *dst = r->frame + r->first / 2;
+    const uint8_t *src = r->strip + (size_t)(r->panel_h - 1) * half;
+
+    if ((r->first / r->strip_rows) & 1) {
+        dst += (size_t)(r->panel_h - 1) * r->stride;
+        src = r->strip;
+        for (int row = 0; row < r->panel_h; row++, dst -= r->stride, src += half) {
+            memcpy(dst, src, n);
+        }
+    } else {
+        for (int row = 0; row < r->panel_h; row++, dst += r->stride, src -= half) {
+            memcpy(dst, src, n);
+        }
+    }
+}
+
+void epd_rotate_put(epd_rotate_t *r, const uint8_t *idx, int y)
+{
+    const size_t half = r->strip_rows / 2;
+    const int k = y - r->first;
+    uint8_t *s = r->strip + k / 2;
+
+    if ((k & 1) == 0) {
+        // 짝수 열 -> 상위 nibble (하위는 홀수 행이 없을 때를 대비해 흰색)
+        for (int c = 0; c < r->panel_h; c++, s += half) {
+            *s = (uint8_t)((idx[c] << 4) | 0x1);
+        }
+    } else {
+        // 홀수 열 -> 하위 nibble
+        for (int c = 0; c < r->panel_h; c++, s += half) {
+            *s = (uint8_t)((*s & 0xF0) | (idx[c] & 0x0F));
+        }
+    }
+
+    if (k + 1 == r->strip_rows || y + 1 == r->panel_w) {
+        epd_rotate_flush(r, k + 1);
+        r->first += r->strip_rows;
+    }
+}
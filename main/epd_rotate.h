@@ -0,0 +1,47 @@
+/*
+ * epd_rotate.h
+ *
+ * 세로 원본(panel_h x panel_w)을 패널 버퍼에 90도 돌려 기록 (띠 단위 전치)
+ *
+ * 원본 한 행은 패널의 한 열이 되므로 행마다 바로 쓰면 패널 버퍼 panel_h개 행에 니블 하나씩
+ * 읽고-고쳐-쓰기가 일어나고, 다음 행이 같은 바이트를 다시 건드린다. 패널 버퍼는 PSRAM에
+ * 있고 행 사이에 PNG 디코더가 캐시를 밀어내므로 이 접근은 대부분 캐시 미스다. 여기서는 원본 strip_rows개 행을 내부 RAM의 띠
+ * 버퍼에 이미 전치된 4bpp 배치로 모았다가, 띠가 차면 패널 행 순서대로 strip_rows/2 바이트씩
+ * memcpy한다. 패널 버퍼의 각 바이트는 한 번만 쓰이고 읽지 않는다.
+ * 하드웨어 쪽 0x00(PSR) 레지스터는 주사 방향 반전(UD/SHL)만 있어서 90도 회전은 못 한다.
+ *
+ * 띠 버퍼 크기: panel_h * strip_rows / 2 바이트 (4.0", 16행: 4,800 바이트)
+ * ESP-IDF 의존성이 없어서 호스트에서도 빌드된다 (tools/epd_rotate_bench.c).
+ */
+#ifndef __EPD_ROTATE_H
+#define __EPD_ROTATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 짝수여야 한다. 16행 = 패널 행마다 8바이트. 캐시 모델(tools/epd_rotate_bench.c)에서
+// 32/64행은 띠 하나가 건드리는 줄이 캐시(32 KB, 2-way)를 넘쳐 미스가 오히려 는다.
+#define EPD_ROTATE_STRIP_ROWS  16
+
+typedef struct {
+    uint8_t *frame;         // 패널 버퍼
+    size_t stride;          // 패널 한 행 바이트 수
+    int panel_w, panel_h;
+    uint8_t *strip;         // panel_h * strip_rows / 2 바이트 (호출자가 내부 RAM에 할당)
+    int strip_rows;
+    int first;              // 띠의 첫 원본 행
+} epd_rotate_t;
+
+static inline size_t epd_rotate_strip_size(int panel_h, int strip_rows)
+{
+    return (size_t)panel_h * strip_rows / 2;
+}
+
+void epd_rotate_init(epd_rotate_t *r, uint8_t *frame, int panel_w, int panel_h,
+                     uint8_t *strip, int strip_rows);
+
+// 원본 행 y(0..panel_w-1, 순서대로)의 4비트 인덱스 panel_h개.
+// 띠가 차거나 마지막 행이면 패널 버퍼로 내보낸다.
+void epd_rotate_put(epd_rotate_t *r, const uint8_t *idx, int y);
+
+#endif
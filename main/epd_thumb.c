@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "epd_color.h"
+#include "epd_thumb.h"
+
+static const char *TAG = "epd_thumb";
+
+// 샘플링 위치: 4x4 블록의 가장자리 대신 안쪽 픽셀
+#define THUMB_PICK 1
+
+// 패널 행 하나(width/2 바이트)를 돌려주는 함수
+typedef const uint8_t *(*thumb_row_fn)(int panel_row, void *arg);
+
+typedef struct {
+    const uint8_t *frame;
+    size_t stride;
+} frame_rows_t;
+
+typedef struct {
+    FILE *fp;
+    long data_pos;
+    size_t stride;
+    uint8_t *row;
+} file_rows_t;
+
+static const uint8_t *row_from_frame(int panel_row, void *arg)
+{
+    frame_rows_t *src = (frame_rows_t *)arg;
+    return src->frame + (size_t)panel_row * src->stride;
+}
+
+static const uint8_t *row_from_file(int panel_row, void *arg)
+{
+    file_rows_t *src = (file_rows_t *)arg;
+    if (fseek(src->fp, src->data_pos + (long)panel_row * (long)src->stride, SEEK_SET) != 0
+        || fread(src->row, 1, src->stride, src->fp) != src->stride) {
+        return NULL;
+    }
+    return src->row;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static void bmp_set(uint8_t *bits, size_t bmp_stride, int th, int tx, int ty, uint8_t idx)
+{
+    // BMP는 아래 행부터 저장
+    uint8_t *p = bits + (size_t)(th - 1 - ty) * bmp_stride + tx / 2;
+    if ((tx & 1) == 0) {
+        *p = (idx << 4) | (*p & 0x0F);
+    } else {
+        *p = (*p & 0xF0) | (idx & 0x0F);
+    }
+}
+
+static bool thumb_write(const char *thumb_path, const epd_frame_header_t *hdr, thumb_row_fn row_fn, void *arg)
+{
+    const int pw = hdr->width;
+    const int ph = hdr->height;
+    const bool rotated = hdr->rotate == 90;
+    // 가로 사진은 원본(ph x pw) 방향으로 되돌린다
+    const int tw = (rotated ? ph : pw) / EPD_THUMB_SCALE;
+    const int th = (rotated ? pw : ph) / EPD_THUMB_SCALE;
+    const size_t bmp_stride = ((tw + 1) / 2 + 3) & ~3u;
+    const size_t bits_size = bmp_stride * th;
+
+    uint8_t *bits = (uint8_t *)calloc(1, bits_size);
+    if (!bits) {
+        ESP_LOGE(TAG, "Failed to allocate thumbnail (%u bytes)", (unsigned)bits_size);
+        return false;
+    }
+
+    // 필요한 패널 행만 읽어서 흩뿌린다
+    // rotate 0 : 미리보기 (tx, ty) <- 패널 (열 tx*4+1, 행 ty*4+1)
+    // rotate 90: 원본 (x, y) = 패널 (열 y, 행 ph-1-x) 이므로
+    //            미리보기 (tx, ty) <- 패널 (열 ty*4+1, 행 ph-1-(tx*4+1))
+    bool ok = true;
+    for (int t = 0; t < (rotated ? tw : th) && ok; t++) {
+        int src = t * EPD_THUMB_SCALE + THUMB_PICK;
+        int panel_row = rotated ? ph - 1 - src : src;
+        const uint8_t *row = row_fn(panel_row, arg);
+        if (!row) {
+            ok = false;
+            break;
+        }
+        for (int u = 0; u < (rotated ? th : tw); u++) {
+            int col = u * EPD_THUMB_SCALE + THUMB_PICK;
+            uint8_t b = row[col / 2];
+            uint8_t idx = (col & 1) ? (b & 0x0F) : (b >> 4);
+            if (rotated) {
+                bmp_set(bits, bmp_stride, th, t, u, idx);
+            } else {
+                bmp_set(bits, bmp_stride, th, u, t, idx);
+            }
+        }
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to read frame rows for %s", thumb_path);
+        free(bits);
+        return false;
+    }
+
+    // BITMAPFILEHEADER(14) + BITMAPINFOHEADER(40) + 팔레트 16색
+    uint8_t head[14 + 40 + 16 * 4];
+    const uint32_t data_off = sizeof(head);
+    memset(head, 0, sizeof(head));
+    head[0] = 'B';
+    head[1] = 'M';
+    put_le32(head + 2, data_off + bits_size);
+    put_le32(head + 10, data_off);
+    put_le32(head + 14, 40);
+    put_le32(head + 18, tw);
+    put_le32(head + 22, th);
+    put_le16(head + 26, 1);                 // planes
+    put_le16(head + 28, 4);                 // bpp
+    put_le32(head + 34, bits_size);
+    put_le32(head + 46, 16);                // 팔레트 색 수
+    for (int i = 0; i < g_color_count; i++) {
+        uint8_t *pal = head + 54 + g_color_table[i].idx4 * 4;
+        pal[0] = g_color_table[i].b;
+        pal[1] = g_color_table[i].g;
+        pal[2] = g_color_table[i].r;
+    }
+
+    // 임시 파일에 쓴 뒤 이름 변경 (쓰다가 전원이 끊겨도 잘린 BMP가 남지 않게)
+    char tmp_path[256];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", thumb_path) >= (int)sizeof(tmp_path)) {
+        ESP_LOGE(TAG, "Thumbnail path too long: %s", thumb_path);
+        free(bits);
+        return false;
+    }
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to create thumbnail: %s", tmp_path);
+        free(bits);
+        return false;
+    }
+    ok = fwrite(head, 1, sizeof(head), fp) == sizeof(head)
+      && fwrite(bits, 1, bits_size, fp) == bits_size;
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    free(bits);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write thumbnail: %s", tmp_path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    // FAT에서는 기존 파일 위로 rename이 안 되므로 먼저 지운다
+    unlink(thumb_path);
+    if (rename(tmp_path, thumb_path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename thumbnail: %s", thumb_path);
+        unlink(tmp_path);
+        return false;
+    }
+    ESP_LOGI(TAG, "Thumbnail saved: %s (%dx%d, %u bytes)", thumb_path, tw, th,
+             (unsigned)(data_off + bits_size));
+    return true;
+}
+
+bool epd_thumb_path(char *out, size_t out_len, const char *png_path)
+{
+    const char *ext = strrchr(png_path, '.');
+    size_t base_len = ext ? (size_t)(ext - png_path) : strlen(png_path);
+    if (base_len + sizeof(EPD_THUMB_EXT) > out_len) {
+        return false;
+    }
+    memcpy(out, png_path, base_len);
+    memcpy(out + base_len, EPD_THUMB_EXT, sizeof(EPD_THUMB_EXT));
+    return true;
+}
+
+bool epd_thumb_write_from_frame(const char *thumb_path, const epd_frame_header_t *hdr, const uint8_t *frame)
+{
+    frame_rows_t src = {
+        .frame = frame,
+        .stride = (hdr->width + 1) / 2,
+    };
+    return thumb_write(thumb_path, hdr, row_from_frame, &src);
+}
+
+bool epd_thumb_write_from_file(const char *thumb_path, const epd_frame_header_t *hdr, FILE *fp)
+{
+    file_rows_t src = {
+        .fp = fp,
+        .data_pos = ftell(fp),
+        .stride = (hdr->width + 1) / 2,
+    };
+    src.row = (uint8_t *)malloc(src.stride);
+    if (!src.row) {
+        return false;
+    }
+    bool ok = thumb_write(thumb_path, hdr, row_from_file, &src);
+    free(src.row);
+    return ok;
+}
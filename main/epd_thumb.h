@@ -0,0 +1,31 @@
+/*
+ * epd_thumb.h
+ *
+ * 웹 갤러리용 미리보기 (<name>.thumb.bmp)
+ *
+ * 변환이 끝난 4비트 패널 프레임에서 4x4마다 한 픽셀을 골라 4bpp BMP로 저장한다.
+ * 양자화/디더링된 프레임에서 만들기 때문에 패널에 실제로 찍히는 색이 그대로 보이고,
+ * PNG를 다시 디코딩하지 않는다. 가로 사진(rotate 90)은 원본 방향으로 되돌려 저장한다.
+ */
+#ifndef __EPD_THUMB_H
+#define __EPD_THUMB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "epd_frame.h"
+
+#define EPD_THUMB_EXT    ".thumb.bmp"
+#define EPD_THUMB_SCALE  4
+
+// "/sdcard/a.png" -> "/sdcard/a.thumb.bmp"
+bool epd_thumb_path(char *out, size_t out_len, const char *png_path);
+
+// 메모리에 있는 패널 프레임에서 미리보기 생성
+bool epd_thumb_write_from_frame(const char *thumb_path, const epd_frame_header_t *hdr, const uint8_t *frame);
+
+// 캐시된 .epd에서 미리보기 생성 (fp는 데이터 시작 위치, 필요한 행만 읽는다)
+bool epd_thumb_write_from_file(const char *thumb_path, const epd_frame_header_t *hdr, FILE *fp);
+
+#endif
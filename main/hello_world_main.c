@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_sleep.h"
+#include "esp_pm.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -15,6 +19,7 @@
 #include "esp_netif.h"
 #include <time.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 // #include "driver/adc.h"
 
 #include "esp_adc/adc_oneshot.h"
@@ -31,17 +36,28 @@
 
 #include "multipart_parser.h"
 #include "driver/spi_common.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #include "Debug.h"
 #include "fonts.h"
 #include "GUI_Paint.h"
+#include "epd_color.h"
+#include "epd_frame.h"
+#include "photo_index.h"
+#include "epd_thumb.h"
+#include "http_file.h"
+#include "epd_compose.h"
+#include "epd_panel.h"
+#include "epd_rotate.h"
 #include "png.h"
 #include "mdns.h"
 
 #define SLEEP_TIME_SEC 60  // 슬립 시간 (초 단위)
 #define RUN_TIME_SEC   60  // 런타임 (초 단위)
 #define INTERVAL_MS    10000 // 힙 메모리 표시 주기 (밀리초 단위)
-#define MAX_FILES 100
 
 // #define DEF_SSID "nurirobot"
 // #define DEF_PW "nuri0625"
@@ -70,6 +86,8 @@ static bool wifi_initialized = false;
 #define MAX_FILE_SIZE   (200*1024) // 200 KB
 #define MAX_FILE_SIZE_STR "200KB"
 #define SCRATCH_BUFSIZE  1024
+#define SD_ALLOCATION_UNIT  (16 * 1024)   // FATFS 클러스터 크기 (업로드 쓰기 단위)
+#define UPLOAD_LOG_STEP     (256 * 1024)  // 업로드 진행 로그 간격
 #define PARALLEL_LINES 16
 
 #define MAX_BOUNDARY_LENGTH 256
@@ -91,68 +109,16 @@ sdmmc_host_t host = SDSPI_HOST_DEFAULT();
 static spi_device_handle_t epd_spi;
 static spi_device_handle_t sd_spi;
 
-#define EPD_4IN0E_WIDTH       400
-#define EPD_4IN0E_HEIGHT      600
-
-#define EPD_4IN0E_BLACK   0x0   /// 000
-#define EPD_4IN0E_WHITE   0x1   /// 001
-#define EPD_4IN0E_YELLOW  0x2   /// 010
-#define EPD_4IN0E_RED     0x3   /// 011
-#define EPD_4IN0E_BLUE    0x5   /// 101
-#define EPD_4IN0E_GREEN   0x6   /// 110
+// 프레임 전송용 DMA 링 설정
+// 큐 깊이는 spi_device_interface_config_t.queue_size 와 같아야 한다.
+#define EPD_DMA_QUEUE_SIZE    7
+#define EPD_DMA_CHUNK_SIZE    2400   // 4.0": 120,000 / 2400 = 50 트랜잭션, 7.3": 80 트랜잭션
 
 #define EXAMPLE_MDNS_INSTANCE CONFIG_MDNS_INSTANCE
 
 int interval_seconds = 60;
 int interval_seconds_onusb = 30;
 
-typedef struct {
-    uint8_t cmd;
-    uint8_t data[16];
-    uint8_t databytes; //No of data in data; bit 7 = delay after set; 0xFF = end of cmds.
-} lcd_init_cmd_t;
-
-DRAM_ATTR static const lcd_init_cmd_t epd_init_cmds[] = {
-    {0xAA, {0x49, 0x55, 0x20, 0x08, 0x09, 0x18}, 6},
-    {0x01, {0x3f}, 1},
-    {0x00, {0x5f, 0x69}, 2},
-    {0x05, {0x40, 0x1f, 0x1f, 0x2c}, 4},
-    {0x08, {0x6f, 0x1f, 0x1f, 0x22}, 4},
-    {0x06, {0x6f, 0x1f, 0x17, 0x17}, 4},
-    {0x03, {0x00, 0x54, 0x00, 0x44}, 4},
-    {0x60, {0x02, 0x00}, 2},
-    {0x30, {0x08}, 1},
-    {0x50, {0x3f}, 1},
-    {0x61, {0x01, 0x90, 0x02, 0x58}, 4},
-    {0xe3, {0x2f}, 1},
-    {0x84, {0x01}, 1},
-    {0, {0}, 0xff},
-};
-
-DRAM_ATTR static const lcd_init_cmd_t epd_utils_cmds[] = {
-    {0x06, {0x6f, 0x1f, 0x17, 0x27}, 4},
-    {0x12, {0x00}, 1},
-    {0x02, {0x00}, 1},
-    {0x07, {0x00}, 1},
-    {0, {0}, 0xff},
-};
-
-typedef struct {
-    uint8_t r, g, b;  // 8비트 RGB
-    uint8_t idx4;     // e-Paper 4비트 컬러 인덱스
-} EPD_ColorMap;
-
-EPD_ColorMap g_color_table[] = {
-    {   0,   0,   0,  EPD_4IN0E_BLACK },  // Black
-    { 255, 255, 255,  EPD_4IN0E_WHITE },  // White
-    { 255, 255,   0,  EPD_4IN0E_YELLOW},  // Yellow
-    { 255,   0,   0,  EPD_4IN0E_RED   },  // Red
-    {   0,   0, 255,  EPD_4IN0E_BLUE  },  // Blue
-    {   0, 255,   0,  EPD_4IN0E_GREEN },  // Green
-    // 필요하다면 다른 색상(Gray 등) 추가 가능
-};
-const int g_color_count = sizeof(g_color_table) / sizeof(g_color_table[0]);
-
 struct file_server_data {
     /* Base path of file storage */
     char base_path[ESP_VFS_PATH_MAX + 1];
@@ -160,8 +126,50 @@ struct file_server_data {
     /* Scratch buffer for temporary storage during file transfer */
     char scratch[SCRATCH_BUFSIZE];
 };
+// SD 카드의 사진 파일(PNG, .epd, 미리보기)을 바꾸는 작업은 한 번에 하나씩 한다.
+// 업로드 확정/변환(httpd 또는 기록 태스크)과 슬라이드쇼 변환(web_server_task)이 같은
+// <png>.epd.tmp 등에 동시에 쓰지 않도록 (CONFIG_FATFS_FS_LOCK=0이라 FATFS가 막아 주지 않는다)
+static SemaphoreHandle_t s_photo_lock = NULL;
+
+static void photo_files_lock(void)
+{
+    xSemaphoreTake(s_photo_lock, portMAX_DELAY);
+}
+
+static void photo_files_unlock(void)
+{
+    xSemaphoreGive(s_photo_lock);
+}
+
 static FILE *current_file = NULL;  // 현재 처리 중인 파일
 static char file_path[256];        // 저장할 파일 경로
+static char upload_tmp_path[sizeof(file_path) + 8];  // 받는 동안 쓰는 임시 파일 (<name>.part)
+static size_t upload_part_bytes = 0;  // 현재 파트에서 받은 바이트 수
+static uint32_t upload_hash = 0;      // 현재 파트의 FNV-1a 32 (받으면서 누적, 다시 읽지 않는다)
+static int upload_frames_ready = 0;   // 업로드 중 패널 프레임 변환 성공 개수
+static int upload_frames_failed = 0;  // 업로드 중 패널 프레임 변환 실패 개수
+static int upload_files_stored = 0;   // 최종 이름으로 저장된 파일 수 (결과 표 크기와 무관)
+static int64_t upload_convert_us = 0; // 업로드 중 변환에 쓴 시간 합 (처리량과 따로 보고)
+
+// 업로드 파일별 결과 (응답 JSON). 표가 차면 나머지는 upload_overflow에 기록하고 개수만 센다
+#define UPLOAD_MAX_RESULTS  16
+
+typedef struct {
+    char name[64];
+    uint32_t size;
+    const char *status;     // "ok", "not_png", "open_failed", "write_failed", "rename_failed", "incomplete"
+    bool frame;             // 패널 프레임 변환 성공
+} upload_result_t;
+
+static upload_result_t upload_results[UPLOAD_MAX_RESULTS];
+static upload_result_t upload_overflow;
+static upload_result_t *upload_cur = &upload_overflow;
+static int upload_file_count = 0;
+
+// 파트 데이터를 클러스터 크기로 모았다가 한 번에 쓰는 버퍼 (http_file 전송 버퍼를 빌려 씀)
+static uint8_t *upload_wbuf = NULL;
+static size_t upload_wbuf_size = 0;
+static size_t upload_wbuf_len = 0;
 
 static wifi_config_t wifi_config = {
     .sta = {
@@ -275,15 +283,177 @@ void lcd_data(spi_device_handle_t spi, const uint8_t *data, int len)
     assert(ret == ESP_OK);          //Should have had no issues.
 }
 
+// 프레임 데이터를 채우는 콜백: dst에 offset 위치부터 len 바이트를 채우고 채운 바이트 수를 반환
+typedef size_t (*epd_fill_cb_t)(uint8_t *dst, size_t offset, size_t len, void *arg);
+
+// DMA 가능한 내부 RAM에 잡아두는 전송 링 (최초 사용 시 한 번만 할당)
+static uint8_t *s_epd_dma_ring[EPD_DMA_QUEUE_SIZE];
+static spi_transaction_t s_epd_dma_trans[EPD_DMA_QUEUE_SIZE];
+
+static bool epd_dma_ring_alloc(void)
+{
+    for (int i = 0; i < EPD_DMA_QUEUE_SIZE; i++) {
+        if (!s_epd_dma_ring[i]) {
+            s_epd_dma_ring[i] = (uint8_t *)heap_caps_malloc(EPD_DMA_CHUNK_SIZE, MALLOC_CAP_DMA);
+            if (!s_epd_dma_ring[i]) {
+                ESP_LOGE("EPD", "Failed to allocate DMA ring buffer %d", i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 메모리 버퍼를 원본으로 쓰는 채우기 콜백
+static size_t epd_fill_from_buffer(uint8_t *dst, size_t offset, size_t len, void *arg)
+{
+    memcpy(dst, (const uint8_t *)arg + offset, len);
+    return len;
+}
+
+// 프레임 스트리밍 전송
+// fill 콜백으로 링 버퍼를 채우고 spi_device_queue_trans로 큐잉한다.
+// 큐가 가득 차면 가장 오래된 트랜잭션이 끝날 때까지 기다린 뒤 그 슬롯을 재사용하므로
+// CPU는 다음 청크를 준비하는 동안 버스가 이전 청크를 내보낸다.
+// (lcd_cmd는 polling 전송이므로 리턴 전에 큐를 모두 비운다)
+// pattern이 있으면 fill 대신 그 청크 하나를 모든 트랜잭션이 그대로 다시 보낸다.
+static esp_err_t epd_push_chunks(epd_fill_cb_t fill, void *arg, const uint8_t *pattern, size_t total)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+#if CONFIG_EPD_PUSH_POLLING
+    // 비교용 기존 경로: SOC_SPI_MAXIMUM_BUFFER_SIZE 단위 polling 전송
+    uint8_t color_buffer[SOC_SPI_MAXIMUM_BUFFER_SIZE];
+    size_t offset = 0;
+    while (offset < total) {
+        size_t chunk_size = MIN(total - offset, SOC_SPI_MAXIMUM_BUFFER_SIZE);
+        if (pattern) {
+            lcd_data(epd_spi, pattern, chunk_size);
+            offset += chunk_size;
+            continue;
+        }
+        if (fill(color_buffer, offset, chunk_size, arg) != chunk_size) {
+            err = ESP_FAIL;
+            break;
+        }
+        lcd_data(epd_spi, color_buffer, chunk_size);
+        offset += chunk_size;
+    }
+    const char *mode = "polling";
+#else
+    if (!epd_dma_ring_alloc()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t offset = 0;
+    int queued = 0;
+    int head = 0;
+    spi_transaction_t *done;
+    while (offset < total) {
+        // 링이 가득 찼으면 가장 오래된 슬롯(head)이 끝나기를 기다림
+        if (queued == EPD_DMA_QUEUE_SIZE) {
+            ESP_ERROR_CHECK(spi_device_get_trans_result(epd_spi, &done, portMAX_DELAY));
+            queued--;
+        }
+
+        size_t chunk_size = MIN(total - offset, EPD_DMA_CHUNK_SIZE);
+        const uint8_t *buf = pattern;
+        if (!buf) {
+            buf = s_epd_dma_ring[head];
+            if (fill(s_epd_dma_ring[head], offset, chunk_size, arg) != chunk_size) {
+                err = ESP_FAIL;
+                break;
+            }
+        }
+
+        spi_transaction_t *t = &s_epd_dma_trans[head];
+        memset(t, 0, sizeof(*t));
+        t->length = chunk_size * 8;
+        t->tx_buffer = buf;
+        t->user = (void*)1;             //D/C needs to be set to 1
+        ESP_ERROR_CHECK(spi_device_queue_trans(epd_spi, t, portMAX_DELAY));
+
+        queued++;
+        head = (head + 1) % EPD_DMA_QUEUE_SIZE;
+        offset += chunk_size;
+    }
+
+    // 남은 트랜잭션 회수
+    while (queued > 0) {
+        ESP_ERROR_CHECK(spi_device_get_trans_result(epd_spi, &done, portMAX_DELAY));
+        queued--;
+    }
+    const char *mode = pattern ? "dma pattern" : "dma queue";
+#endif
+
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    ESP_LOGI("EPD", "frame push (%s): %u/%u bytes in %lld us", mode,
+             (unsigned)offset, (unsigned)total, (long long)elapsed_us);
+    if (err != ESP_OK) {
+        ESP_LOGE("EPD", "frame source ended early at %u bytes", (unsigned)offset);
+    }
+    return err;
+}
+
+esp_err_t epd_push_stream(epd_fill_cb_t fill, void *arg, size_t total)
+{
+    return epd_push_chunks(fill, arg, NULL, total);
+}
+
+// 한 값으로 total 바이트 전송 (clear/fill)
+// 패턴 청크 하나만 채워 두고 (DMA 링의 첫 슬롯) 모든 트랜잭션이 그 버퍼를 다시 보낸다.
+// 프레임 크기 버퍼도, 청크마다 채우는 루프도 없다.
+esp_err_t epd_push_fill(uint8_t value, size_t total)
+{
+#if CONFIG_EPD_PUSH_POLLING
+    uint8_t pattern[SOC_SPI_MAXIMUM_BUFFER_SIZE];
+    memset(pattern, value, sizeof(pattern));
+#else
+    if (!epd_dma_ring_alloc()) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t *pattern = s_epd_dma_ring[0];
+    memset(pattern, value, EPD_DMA_CHUNK_SIZE);
+#endif
+    return epd_push_chunks(NULL, NULL, pattern, total);
+}
+
+// 메모리에 있는 프레임 전송
+esp_err_t epd_push_frame(const uint8_t *frame, size_t len)
+{
+    return epd_push_stream(epd_fill_from_buffer, (void *)frame, len);
+}
+
+// 열린 파일(FILE *)을 원본으로 쓰는 채우기 콜백: 순서대로 읽으므로 offset은 쓰지 않음
+static size_t epd_fill_from_file(uint8_t *dst, size_t offset, size_t len, void *arg)
+{
+    return fread(dst, 1, len, (FILE *)arg);
+}
+
 // 콜백 함수: 헤더 필드 처리
 static int handle_header_field(multipart_parser *p, const char *at, size_t length)
 {
-    char field[256];
-    snprintf(field, sizeof(field), "%.*s", (int)length, at);
-    ESP_LOGI(TAG, "Header Field: %s", field);
+    ESP_LOGD(TAG, "Header Field: %.*s", (int)length, at);
     return 0;
 }
 
+static const uint8_t upload_png_sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// 현재 파트를 버린다: 임시 파일을 지우고 이 파트의 남은 데이터는 무시
+static void upload_abort_part(const char *status)
+{
+    if (current_file) {
+        fclose(current_file);
+        current_file = NULL;
+        unlink(upload_tmp_path);
+    }
+    upload_wbuf_len = 0;
+    upload_cur->status = status;
+    upload_cur->size = upload_part_bytes;
+    ESP_LOGW(TAG, "upload: %s %s", file_path, status);
+}
+
 // 콜백 함수: 헤더 값 처리
 static int handle_header_value(multipart_parser *p, const char *at, size_t length)
 {
@@ -295,63 +465,193 @@ static int handle_header_value(multipart_parser *p, const char *at, size_t lengt
         char *start = strstr(value, "filename=\"") + 10;
         char *end = strchr(start, '\"');
         if (start && end) {
-            snprintf(file_path, sizeof(file_path), MOUNT_POINT "/%.*s", (int)(end - start), start);
-            ESP_LOGI(TAG, "Parsed File Name: %s", file_path);
-
-            // 기존 파일 닫기
+            // 끝나지 않은 이전 파트
             if (current_file) {
-                fclose(current_file);
-                current_file = NULL;
+                upload_abort_part("incomplete");
             }
 
-            // 새로운 파일 열기
-            current_file = fopen(file_path, "w");
+            snprintf(file_path, sizeof(file_path), MOUNT_POINT "/%.*s", (int)(end - start), start);
+            snprintf(upload_tmp_path, sizeof(upload_tmp_path), "%s" PHOTO_UPLOAD_TMP_EXT, file_path);
+            ESP_LOGI(TAG, "Parsed File Name: %s", file_path);
+
+            upload_cur = upload_file_count < UPLOAD_MAX_RESULTS ? &upload_results[upload_file_count] : &upload_overflow;
+            upload_file_count++;
+            memset(upload_cur, 0, sizeof(*upload_cur));
+            snprintf(upload_cur->name, sizeof(upload_cur->name), "%.*s", (int)(end - start), start);
+            upload_cur->status = "incomplete";
+            upload_part_bytes = 0;
+            upload_hash = EPD_FNV1A_INIT;
+            upload_wbuf_len = 0;
+
+            // 최종 이름은 파트가 끝까지 도착한 뒤에 rename으로 만든다.
+            // 모아 둔 클러스터 단위로만 쓰므로 stdio 버퍼는 끈다.
+            // 열기에 실패하면 이 파트만 건너뛰고 나머지 파일은 계속 받는다.
+            current_file = fopen(upload_tmp_path, "w");
             if (!current_file) {
-                ESP_LOGE(TAG, "Failed to open file: %s", file_path);
-                return -1;
+                ESP_LOGE(TAG, "Failed to open file: %s", upload_tmp_path);
+                upload_cur->status = "open_failed";
+                return 0;
             }
+            setvbuf(current_file, NULL, _IONBF, 0);
         }
     }
-    ESP_LOGI(TAG, "Header Value: %s", value);
+    ESP_LOGD(TAG, "Header Value: %s", value);
     return 0;
 }
 
 // 콜백 함수: 파트 데이터 시작
 static int handle_part_data_begin(multipart_parser *p)
 {
-    ESP_LOGI(TAG, "Part Data Begin");
+    ESP_LOGD(TAG, "Part Data Begin");
     return 0;
 }
 
+static bool upload_write(const void *data, size_t len)
+{
+    if (len && fwrite(data, 1, len, current_file) != len) {
+        ESP_LOGE(TAG, "Failed to write data to file");
+        upload_abort_part("write_failed");
+        return false;
+    }
+    return true;
+}
+
 // 콜백 함수: 파트 데이터 처리
+// 파서는 수신 버퍼 안을 가리키는 조각을 넘기지만 본문의 CR마다 끊기므로 (PNG면 평균 256바이트)
+// 그대로 fwrite하지 않고 클러스터 크기로 모아서 쓴다.
+// 실패한 파트는 버리고 0을 돌려준다 (-1이면 파서가 수신 버퍼 나머지를 건너뛰어 다음 파트까지 깨진다).
 static int handle_part_data(multipart_parser *p, const char *at, size_t length)
 {
-    if (current_file) {
-        if (fwrite(at, 1, length, current_file) != length) {
-            ESP_LOGE(TAG, "Failed to write data to file");
-            fclose(current_file);
-            current_file = NULL;
-            return -1;
+    if (!current_file) {
+        return 0;
+    }
+
+    // PNG 시그니처는 첫 조각에서 확인한다 (전부 받은 뒤 디코딩에서 실패하지 않도록)
+    if (upload_part_bytes < sizeof(upload_png_sig) && IS_FILE_EXT(file_path, ".png")) {
+        size_t n = MIN(length, sizeof(upload_png_sig) - upload_part_bytes);
+        if (memcmp(at, upload_png_sig + upload_part_bytes, n) != 0) {
+            upload_abort_part("not_png");
+            return 0;
+        }
+    }
+    upload_part_bytes += length;
+    upload_hash = epd_fnv1a(upload_hash, at, length);
+
+    if (!upload_wbuf) {
+        upload_write(at, length);
+        return 0;
+    }
+    while (length > 0) {
+        size_t n = MIN(length, upload_wbuf_size - upload_wbuf_len);
+        memcpy(upload_wbuf + upload_wbuf_len, at, n);
+        upload_wbuf_len += n;
+        at += n;
+        length -= n;
+        if (upload_wbuf_len == upload_wbuf_size) {
+            upload_wbuf_len = 0;
+            if (!upload_write(upload_wbuf, upload_wbuf_size)) {
+                return 0;
+            }
         }
     }
     return 0;
 }
 
+bool convert_png_to_frame(const char *png_path, uint8_t *epd_buffer, size_t buf_size, epd_frame_header_t *hdr,
+                          uint32_t src_hash);
+bool frame_expect_for_png(const char *png_path, char *frame_path, size_t path_len, epd_frame_header_t *expect);
+
+// 업로드된 PNG를 바로 패널 프레임(.epd)으로 변환
+// 사용자가 어차피 응답을 기다리는 동안 변환 비용을 치르고, 표시 주기에는 파일 I/O만 남긴다.
+// src_hash는 받으면서 계산한 원본 해시 (변환에서 다시 계산하지 않음)
+static bool convert_uploaded_png(const char *png_path, uint32_t src_hash)
+{
+    size_t buf_size = EPD_PANEL_FRAME_SIZE;
+
+    uint8_t *epd_buffer = (uint8_t *)malloc(buf_size);
+    if (!epd_buffer) {
+        ESP_LOGE(TAG, "Failed to allocate epd_buffer for %s", png_path);
+        upload_frames_failed++;
+        photo_index_update_file(png_path, NULL, src_hash);
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    epd_frame_header_t hdr;
+    bool ok = convert_png_to_frame(png_path, epd_buffer, buf_size, &hdr, src_hash);
+    if (ok) {
+        upload_frames_ready++;
+        ESP_LOGI(TAG, "Upload converted: %s in %lld ms", png_path,
+                 (long long)((esp_timer_get_time() - start_us) / 1000));
+    } else {
+        upload_frames_failed++;
+        photo_index_update_file(png_path, NULL, src_hash);  // 변환은 실패해도 목록에는 올린다
+    }
+    free(epd_buffer);
+    upload_convert_us += esp_timer_get_time() - start_us;
+    return ok;
+}
+
 // 콜백 함수: 파트 데이터 끝
 static int handle_part_data_end(multipart_parser *p)
 {
-    ESP_LOGI(TAG, "Part Data End");
-    if (current_file) {
-        fclose(current_file);
-        current_file = NULL;
+    ESP_LOGD(TAG, "Part Data End");
+    if (!current_file) {
+        return 0;
+    }
+
+    size_t tail = upload_wbuf_len;
+    upload_wbuf_len = 0;
+    if (!upload_write(upload_wbuf, tail)) {
+        return 0;
+    }
+    if (IS_FILE_EXT(file_path, ".png") && upload_part_bytes < sizeof(upload_png_sig)) {
+        upload_abort_part("not_png");
+        return 0;
+    }
+    fclose(current_file);
+    current_file = NULL;
+
+    // 확정과 변환은 표시 쪽 변환과 겹치지 않게 잠금 안에서
+    photo_files_lock();
+
+    // 다 받은 파일만 최종 이름으로. FATFS rename은 대상이 있으면 실패하므로 예전 파일은
+    // <name>.old로 옮겨 두었다가 성공하면 지우고, 실패하면 되돌려서 예전 사진을 지킨다.
+    char old_path[sizeof(upload_tmp_path)];
+    snprintf(old_path, sizeof(old_path), "%s" PHOTO_UPLOAD_OLD_EXT, file_path);
+    unlink(old_path);
+    bool replaced = rename(file_path, old_path) == 0;
+    if (rename(upload_tmp_path, file_path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s", upload_tmp_path);
+        unlink(upload_tmp_path);
+        if (replaced && rename(old_path, file_path) != 0) {
+            // 되돌리지 못하면 목록에서 뺀다 (.old는 다음 재구성 때 되돌린다)
+            ESP_LOGE(TAG, "Failed to restore %s", file_path);
+            photo_index_remove(file_path);
+        }
+        photo_files_unlock();
+        upload_cur->status = "rename_failed";
+        return 0;
+    }
+    if (replaced) {
+        unlink(old_path);
+    }
+    upload_cur->status = "ok";
+    upload_files_stored++;
+    upload_cur->size = upload_part_bytes;
+    ESP_LOGI(TAG, "upload: %s (%u KB)", file_path, (unsigned)(upload_part_bytes / 1024));
+
+    if (IS_FILE_EXT(file_path, ".png")) {
+        upload_cur->frame = convert_uploaded_png(file_path, upload_hash);
     }
+    photo_files_unlock();
     return 0;
 }
 
 // 콜백 함수: 본문 끝
 static int handle_body_end(multipart_parser *p)
 {
-    ESP_LOGI(TAG, "Body End");
+    ESP_LOGD(TAG, "Body End");
     return 0;
 }
 
@@ -369,6 +669,10 @@ void init_sd_card()
 {
     ESP_LOGI(TAG, "SD 카드(SPI) 초기화 중...");
 
+    if (!s_photo_lock) {
+        s_photo_lock = xSemaphoreCreateMutex();
+    }
+
     // SPI 호스트 초기화
     // sdmmc_host_t host = SDSPI_HOST_DEFAULT();
     // spi_bus_config_t bus_cfg = {
@@ -389,7 +693,7 @@ void init_sd_card()
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
         .max_files = 5,
-        .allocation_unit_size = 16 * 1024,
+        .allocation_unit_size = SD_ALLOCATION_UNIT,
     };
 
     sdmmc_card_t *card;
@@ -425,6 +729,168 @@ void write_to_sdcard()
     ESP_LOGI(TAG, "파일 작성 완료: %s", file_path);
 }
 
+// BUSY 핀 인터럽트 대기
+// LOW: busy, HIGH: idle
+// 기다릴 레벨의 인터럽트를 켜 두고 ISR이 세마포어를 주면 깨어난다 (폴링 없음).
+// 레벨 인터럽트라 ISR에서 바로 비활성화하고, 대기할 때마다 다시 켠다.
+static SemaphoreHandle_t s_epd_busy_sem;
+
+static void IRAM_ATTR epd_busy_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    gpio_intr_disable(EPD_BUSY_PIN);
+    xSemaphoreGiveFromISR(s_epd_busy_sem, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void epd_busy_init(void)
+{
+    // gpio_init()이 다시 불려도 세마포어/핸들러를 한 번만 만든다
+    if (s_epd_busy_sem) {
+        return;
+    }
+    s_epd_busy_sem = xSemaphoreCreateBinary();
+    ESP_ERROR_CHECK(s_epd_busy_sem ? ESP_OK : ESP_ERR_NO_MEM);
+    gpio_set_intr_type(EPD_BUSY_PIN, GPIO_INTR_HIGH_LEVEL);
+
+    // 다른 곳에서 이미 설치했으면 ESP_ERR_INVALID_STATE
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(ret);
+    }
+    ESP_ERROR_CHECK(gpio_isr_handler_add(EPD_BUSY_PIN, epd_busy_isr, NULL));
+    gpio_intr_disable(EPD_BUSY_PIN);
+}
+
+// 리셋 펄스만 (BUSY 대기 없음)
+static void epd_reset_pulse(void)
+{
+    gpio_set_level(EPD_RST_PIN, 0);
+    vTaskDelay(pdMS_TO_TICKS(20));    // 2ms 지연    
+    gpio_set_level(EPD_RST_PIN, 1);
+    vTaskDelay(pdMS_TO_TICKS(20));   // 20ms 지연
+    gpio_set_level(EPD_RST_PIN, 0);
+    vTaskDelay(pdMS_TO_TICKS(20));    // 2ms 지연
+    gpio_set_level(EPD_RST_PIN, 1);
+    vTaskDelay(pdMS_TO_TICKS(20));   // 20ms 지연    
+}
+
+// 갱신 중 자동 light sleep
+// 평소에는 ESP_PM_NO_LIGHT_SLEEP 락을 잡아 두고, 긴 갱신 대기 동안만 풀어 준다.
+// BUSY 핀 HIGH 레벨을 GPIO 깨우기 원인으로 등록해 갱신이 끝나면 바로 깨어난다.
+static esp_pm_lock_handle_t s_epd_pm_lock;
+static volatile int64_t s_epd_slept_us;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static esp_err_t IRAM_ATTR epd_light_sleep_exit_cb(int64_t sleep_time_us, void *arg)
+{
+    s_epd_slept_us += sleep_time_us;
+    return ESP_OK;
+}
+#endif
+
+void epd_pm_init(void)
+{
+#if CONFIG_EPD_REFRESH_LIGHT_SLEEP
+    // DFS는 쓰지 않음 (min == max), light sleep만 허용
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "epd", &s_epd_pm_lock));
+    ESP_ERROR_CHECK(esp_pm_lock_acquire(s_epd_pm_lock));
+
+    ESP_ERROR_CHECK(gpio_wakeup_enable(EPD_BUSY_PIN, GPIO_INTR_HIGH_LEVEL));
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = epd_light_sleep_exit_cb,
+    };
+    ESP_ERROR_CHECK(esp_pm_light_sleep_register_cbs(&cbs));
+#endif
+    ESP_LOGI(TAG, "Light sleep during panel refresh enabled");
+#endif
+}
+
+// BUSY 핀이 level이 될 때까지 인터럽트로 대기 (이미 그 레벨이면 바로 반환)
+static bool epd_busy_wait_level(gpio_int_type_t level, uint32_t timeout_ms)
+{
+    xSemaphoreTake(s_epd_busy_sem, 0);    // 이전에 남은 신호 비우기
+    gpio_set_intr_type(EPD_BUSY_PIN, level);
+    gpio_intr_enable(EPD_BUSY_PIN);       // 이미 그 레벨이면 바로 ISR 발생
+    if (xSemaphoreTake(s_epd_busy_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        gpio_intr_disable(EPD_BUSY_PIN);
+        return false;
+    }
+    return true;
+}
+
+// Busy 핀이 HIGH(idle)가 될 때까지 대기
+// 명령 직후에는 컨트롤러가 아직 BUSY를 내리지 않았을 수 있으므로, 먼저 BUSY가 LOW로
+// 떨어지는 것을 짧게(CONFIG_EPD_BUSY_ASSERT_TIMEOUT_MS) 기다린 뒤 해제를 기다린다.
+// 그 시간 안에 떨어지지 않으면 이미 끝난 명령으로 보고 해제 대기로 넘어간다.
+// what: 로그용 명령 이름. 실제 busy 시간을 명령마다 남긴다.
+// light_sleep: 대기 중 자동 light sleep 허용 (긴 갱신 대기용)
+// 시간 초과 시 하드웨어 리셋으로 컨트롤러를 복구하고 ESP_ERR_TIMEOUT 반환
+esp_err_t epd_wait_idle(const char *what, bool light_sleep)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    if (!epd_busy_wait_level(GPIO_INTR_LOW_LEVEL, CONFIG_EPD_BUSY_ASSERT_TIMEOUT_MS)) {
+        ESP_LOGD("EPD", "busy %s: not asserted within %d ms", what, CONFIG_EPD_BUSY_ASSERT_TIMEOUT_MS);
+    }
+    int64_t assert_us = esp_timer_get_time();
+
+    light_sleep = light_sleep && s_epd_pm_lock;
+    if (light_sleep) {
+        s_epd_slept_us = 0;
+        esp_pm_lock_release(s_epd_pm_lock);
+    }
+
+    // light sleep 깨우기 원인과 같은 HIGH 레벨로 되돌려 둔다
+    if (!epd_busy_wait_level(GPIO_INTR_HIGH_LEVEL, CONFIG_EPD_BUSY_TIMEOUT_MS)) {
+        ESP_LOGE("EPD", "busy %s: no release within %d ms, forcing hardware reset",
+                 what, CONFIG_EPD_BUSY_TIMEOUT_MS);
+        epd_reset_pulse();
+        err = ESP_ERR_TIMEOUT;
+    }
+
+    if (light_sleep) {
+        esp_pm_lock_acquire(s_epd_pm_lock);
+    }
+
+    int64_t busy_ms = (esp_timer_get_time() - start_us) / 1000;
+    if (light_sleep) {
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+        int64_t slept_ms = s_epd_slept_us / 1000;
+        ESP_LOGI("EPD", "busy %s: %lld ms (light sleep %lld ms, awake %lld ms)", what,
+                 (long long)busy_ms, (long long)slept_ms, (long long)(busy_ms - slept_ms));
+#else
+        ESP_LOGI("EPD", "busy %s: %lld ms (light sleep allowed)", what, (long long)busy_ms);
+#endif
+    } else {
+        ESP_LOGI("EPD", "busy %s: %lld ms (asserted after %lld ms)", what, (long long)busy_ms,
+                 (long long)((assert_us - start_us) / 1000));
+    }
+
+    // Busy pin이 HIGH가 된 후 추가 안정화 시간
+    if (CONFIG_EPD_BUSY_SETTLE_MS > 0) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_EPD_BUSY_SETTLE_MS));
+    }
+    return err;
+}
+
 void gpio_init() 
 {
     gpio_set_direction(EPD_BUSY_PIN, GPIO_MODE_INPUT);
@@ -437,19 +903,8 @@ void gpio_init()
     gpio_set_level(EPD_PWR_PIN, 1);
     gpio_set_level(EPD_CS_PIN,  1);
     gpio_set_level(SD_CS_PIN,   0);
-}
 
-void epd_ReadBusyH() {
-    ESP_LOGI(TAG, "e-Paper busy H");
-    // LOW: busy, HIGH: idle
-    // 바뀐 논리에 따라, Busy 핀이 HIGH(1)가 될 때까지 대기
-    while (gpio_get_level(EPD_BUSY_PIN) == 0) {
-        vTaskDelay(pdMS_TO_TICKS(10));  // 10ms 대기
-    }
-
-    // Busy pin이 HIGH가 된 후 추가로 200ms 정도 대기
-    vTaskDelay(pdMS_TO_TICKS(200));
-    ESP_LOGI(TAG, "e-Paper busy H release");    
+    epd_busy_init();
 }
 
 void epd_spi_pre_transfer_callback(spi_transaction_t *t)
@@ -487,16 +942,16 @@ void epd_spi_pre_transfer_callback(spi_transaction_t *t)
 //     ESP_LOGI(TAG, "e-Paper busy H release");    
 // }    
 
+// 명령 한 개와 데이터 전송
+static void epd_send_cmd(const lcd_init_cmd_t *c)
+{
+    lcd_cmd(epd_spi, c->cmd, false);
+    lcd_data(epd_spi, c->data, c->databytes & 0x1F);
+}
+
 void epd_reset() {
-    gpio_set_level(EPD_RST_PIN, 0);
-    vTaskDelay(pdMS_TO_TICKS(20));    // 2ms 지연    
-    gpio_set_level(EPD_RST_PIN, 1);
-    vTaskDelay(pdMS_TO_TICKS(20));   // 20ms 지연
-    gpio_set_level(EPD_RST_PIN, 0);
-    vTaskDelay(pdMS_TO_TICKS(20));    // 2ms 지연
-    gpio_set_level(EPD_RST_PIN, 1);
-    vTaskDelay(pdMS_TO_TICKS(20));   // 20ms 지연    
-    epd_ReadBusyH();
+    epd_reset_pulse();
+    epd_wait_idle("reset", false);
 }
 
 void epd_init() {
@@ -506,170 +961,95 @@ void epd_init() {
     vTaskDelay(pdMS_TO_TICKS(100));
 
     epd_reset();
-    // epd_ReadBusyH();
-    vTaskDelay(pdMS_TO_TICKS(30));
-    int cmd = 0;
-    while (epd_init_cmds[cmd].databytes != 0xff) {
-        lcd_cmd(epd_spi, epd_init_cmds[cmd].cmd, false);
-        lcd_data(epd_spi, epd_init_cmds[cmd].data, epd_init_cmds[cmd].databytes & 0x1F);
-        if (epd_init_cmds[cmd].databytes & 0x80) {
+    // epd_wait_idle("reset", false);
+    vTaskDelay(pdMS_TO_TICKS(epd_panel.reset_settle_ms));
+    for (const lcd_init_cmd_t *c = epd_panel.init_cmds; c->databytes != 0xff; c++) {
+        epd_send_cmd(c);
+        if (c->databytes & 0x80) {
             vTaskDelay(100 / portTICK_PERIOD_MS);
         }
-        cmd++;
     }
-    epd_ReadBusyH();
+    epd_wait_idle("init", false);
 }
 
 void epd_turnondisplay() {
-    lcd_cmd(epd_spi, 0x04, false);
-    epd_ReadBusyH();
-    vTaskDelay(pdMS_TO_TICKS(200));
+    lcd_cmd(epd_spi, epd_panel.power_on_cmd, false);
+    epd_wait_idle("power on", false);
+    vTaskDelay(pdMS_TO_TICKS(epd_panel.power_settle_ms));
 
-    lcd_cmd(epd_spi, epd_utils_cmds[0].cmd, false);
-    lcd_data(epd_spi, epd_utils_cmds[0].data, epd_utils_cmds[0].databytes & 0x1F);
-    vTaskDelay(pdMS_TO_TICKS(200));
+    epd_send_cmd(&epd_panel.booster);
+    vTaskDelay(pdMS_TO_TICKS(epd_panel.power_settle_ms));
 
-    lcd_cmd(epd_spi, epd_utils_cmds[1].cmd, false);
-    lcd_data(epd_spi, epd_utils_cmds[1].data, epd_utils_cmds[1].databytes & 0x1F);
-    vTaskDelay(pdMS_TO_TICKS(200));
+    // 갱신은 고정 지연 대신 BUSY 해제까지 기다린다 (실제 갱신 시간이 로그에 남음)
+    epd_send_cmd(&epd_panel.refresh);
+    epd_wait_idle("refresh", true);
 
-    lcd_cmd(epd_spi, epd_utils_cmds[2].cmd, false);
-    lcd_data(epd_spi, epd_utils_cmds[2].data, epd_utils_cmds[2].databytes & 0x1F);
-    epd_ReadBusyH();
-    vTaskDelay(pdMS_TO_TICKS(200));    
+    epd_send_cmd(&epd_panel.power_off);
+    epd_wait_idle("power off", false);
 }
 
 void epd_sleep() {
-    lcd_cmd(epd_spi, epd_utils_cmds[3].cmd, false);
-    lcd_data(epd_spi, epd_utils_cmds[3].data, epd_utils_cmds[3].databytes & 0x1F);
-    epd_ReadBusyH();
+    epd_send_cmd(&epd_panel.deep_sleep);
+    epd_wait_idle("sleep", false);
 }
 
-void epd_display(const UBYTE *Image) 
+// 프레임 데이터를 fill 콜백으로 받아 패널 메모리에 전송만 한다 (갱신은 epd_turnondisplay)
+esp_err_t epd_load_stream(epd_fill_cb_t fill, void *arg, size_t len)
 {
-    uint16_t Width = (EPD_4IN0E_WIDTH % 2 == 0)
-                   ? (EPD_4IN0E_WIDTH / 2)
-                   : (EPD_4IN0E_WIDTH / 2 + 1);
-    uint16_t Height = EPD_4IN0E_HEIGHT;
-
-    size_t buffer_size = Width * Height;
-    // ESP_LOGI("EPD", "buffer_size: %d %d", buffer_size, Width);
-    // ESP_LOG_BUFFER_HEXDUMP("EPD", Image, 32, ESP_LOG_INFO);
-    lcd_cmd(epd_spi, 0x10, false);
-    size_t offset = 0;
-    uint8_t *color_buffer = (uint8_t*)malloc(SOC_SPI_MAXIMUM_BUFFER_SIZE);
-    while (offset < buffer_size) {
-        // 남은 데이터 중에서 chunk 크기 결정
-        size_t remain = buffer_size - offset;
-        size_t chunk_size = (remain > SOC_SPI_MAXIMUM_BUFFER_SIZE) 
-                            ? SOC_SPI_MAXIMUM_BUFFER_SIZE 
-                            : remain;
-
-        // color_buffer + offset 위치부터 chunk_size 바이트 전송
-        for(int i=0; i<chunk_size; i++) {
-            color_buffer[i] = Image[offset + i];
-            // ESP_LOGI("EPD", "offset + i : %d", offset + i);
-        }
-
-        lcd_data(epd_spi, color_buffer, chunk_size);
-        // ESP_LOG_BUFFER_HEXDUMP("EPD", color_buffer, 16, ESP_LOG_INFO);
-
-        offset += chunk_size;
-    }  
-    free(color_buffer);
-
-    epd_turnondisplay();  
+    lcd_cmd(epd_spi, epd_panel.frame_cmd, false);
+    esp_err_t err = epd_push_stream(fill, arg, len);
+    if (err != ESP_OK) {
+        ESP_LOGE("EPD", "frame push failed (%s), skipping refresh", esp_err_to_name(err));
+    }
+    return err;
 }
 
-void epd_displaypart(const UBYTE *Image, UWORD xstart, UWORD ystart, UWORD image_width, UWORD image_heigh)
+// 프레임 데이터를 fill 콜백으로 받아 전송 후 화면 갱신
+// 원본이 중간에 끊기면 갱신하지 않고 (패널은 이전 화면 유지) 오류를 돌려준다.
+esp_err_t epd_display_stream(epd_fill_cb_t fill, void *arg, size_t len)
 {
-    uint16_t Width = (EPD_4IN0E_WIDTH % 2 == 0)
-                   ? (EPD_4IN0E_WIDTH / 2)
-                   : (EPD_4IN0E_WIDTH / 2 + 1);
-    uint16_t Height = EPD_4IN0E_HEIGHT;
-
-    size_t buffer_size = Width * Height;
-    // ESP_LOGI("EPD", "buffer_size: %d %d", buffer_size, Width);
-    uint8_t *color_buffer = (uint8_t*)malloc(buffer_size);
-    if (!color_buffer) {
-        ESP_LOGE("EPD", "Failed to allocate color_buffer");
-        return;
+    esp_err_t err = epd_load_stream(fill, arg, len);
+    if (err != ESP_OK) {
+        return err;
     }
-
-    for(int i=0; i<Height; i++) {
-		for(int j=0; j<Width; j++) {
-            size_t idx = i * Width + j;
-			if((i<(image_heigh+ystart)) && (i>=ystart) && (j<((image_width+xstart)/2)) && (j>=(xstart/2))) {
-                color_buffer[idx] = Image[(j-xstart/2) + (image_width/2*(i-ystart))];
-			}
-			else {
-                color_buffer[idx] = 0x11;
-			}
-		}
-	}    
-
-    lcd_cmd(epd_spi, 0x10, false);
-    size_t offset = 0;
-    while (offset < buffer_size) {
-        // 남은 데이터 중에서 chunk 크기 결정
-        size_t remain = buffer_size - offset;
-        size_t chunk_size = (remain > SOC_SPI_MAXIMUM_BUFFER_SIZE) 
-                            ? SOC_SPI_MAXIMUM_BUFFER_SIZE 
-                            : remain;
-
-        // color_buffer + offset 위치부터 chunk_size 바이트 전송
-        lcd_data(epd_spi, color_buffer + offset, chunk_size);
-        // ESP_LOG_BUFFER_HEXDUMP("EPD", color_buffer + offset, 16, ESP_LOG_INFO);
-
-        offset += chunk_size;
-    }
-
-    free(color_buffer);
     epd_turnondisplay();
+    return ESP_OK;
 }
 
-void epd_clear(uint8_t color)
+void epd_display(const UBYTE *Image) 
 {
-    // Width: 실제 픽셀의 절반 (2픽셀당 1바이트 구조 가정)
-    uint16_t Width = (EPD_4IN0E_WIDTH % 2 == 0)
-                   ? (EPD_4IN0E_WIDTH / 2)
-                   : (EPD_4IN0E_WIDTH / 2 + 1);
-    uint16_t Height = EPD_4IN0E_HEIGHT;
-
-    size_t buffer_size = Width * Height;
-    ESP_LOGI("EPD", "buffer_size: %d", buffer_size);
-    uint8_t *color_buffer = (uint8_t*)malloc(buffer_size);
-    if (!color_buffer) {
-        ESP_LOGE("EPD", "Failed to allocate color_buffer");
-        return;
-    }
+    epd_display_stream(epd_fill_from_buffer, (void *)Image, EPD_PANEL_FRAME_SIZE);
+}
 
-    // 버퍼 전체를 (color<<4 | color)로 채움
-    uint8_t fill_value = (color << 4) | color;
-    for (size_t i = 0; i < buffer_size; i++) {
-        color_buffer[i] = fill_value;
-    }
+// 창(사각형) 갱신: epd_compose가 DMA 링 청크를 행 구간 단위로 바로 채운다
+static size_t epd_fill_window(uint8_t *dst, size_t offset, size_t len, void *arg)
+{
+    return epd_compose_fill((const epd_compose_t *)arg, dst, offset, len);
+}
 
-    // 버퍼 전체를 한 번에 전송
-    // SOC_SPI_MAXIMUM_BUFFER_SIZE로 나누어 전송
-    lcd_cmd(epd_spi, 0x10, false);
-    size_t offset = 0;
-    while (offset < buffer_size) {
-        // 남은 데이터 중에서 chunk 크기 결정
-        size_t remain = buffer_size - offset;
-        size_t chunk_size = (remain > SOC_SPI_MAXIMUM_BUFFER_SIZE) 
-                            ? SOC_SPI_MAXIMUM_BUFFER_SIZE 
-                            : remain;
+// Image(image_width x image_heigh, 4bpp)를 (xstart, ystart)에 두고 나머지는 bg_color로 갱신
+// 이 패널(Spectra 6)은 부분 갱신 명령이 없어 패널에는 프레임 전체를 보내지만,
+// 창 밖은 전송하면서 바로 채우므로 시계/배터리 배지 같은 오버레이도 메모리 할당 없이 그린다.
+void epd_display_window(const UBYTE *Image, UWORD xstart, UWORD ystart,
+                        UWORD image_width, UWORD image_heigh, UBYTE bg_color)
+{
+    epd_compose_t w;
+    epd_compose_init(&w, Image, image_width, image_heigh, xstart, ystart,
+                     EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT, bg_color);
+    epd_display_stream(epd_fill_window, &w, EPD_PANEL_FRAME_SIZE);
+}
 
-        // color_buffer + offset 위치부터 chunk_size 바이트 전송
-        lcd_data(epd_spi, color_buffer + offset, chunk_size);
-        // ESP_LOG_BUFFER_HEXDUMP("EPD", color_buffer + offset, 16, ESP_LOG_INFO);
+void epd_displaypart(const UBYTE *Image, UWORD xstart, UWORD ystart, UWORD image_width, UWORD image_heigh)
+{
+    epd_display_window(Image, xstart, ystart, image_width, image_heigh, EPD_4IN0E_WHITE);
+}
 
-        offset += chunk_size;
-    }
+void epd_clear(uint8_t color)
+{
+    // (color<<4 | color) 패턴 청크 하나를 반복 전송
+    lcd_cmd(epd_spi, epd_panel.frame_cmd, false);
+    epd_push_fill((color << 4) | color, EPD_PANEL_FRAME_SIZE);
 
-    // 버퍼 해제
-    free(color_buffer);
     // 디스플레이 갱신 명령
     epd_turnondisplay();
 }
@@ -690,7 +1070,7 @@ void spi_init()
         .clock_speed_hz = 40 * 1000 * 1000,     //Clock out at 10 MHz
         .mode = 0,                              //SPI mode 0
         .spics_io_num = EPD_CS_PIN,             //CS pin
-        .queue_size = 7,                        //We want to be able to queue 7 transactions at a time
+        .queue_size = EPD_DMA_QUEUE_SIZE,       //We want to be able to queue 7 transactions at a time
         .pre_cb = epd_spi_pre_transfer_callback,
     };
 
@@ -714,14 +1094,16 @@ void spi_init()
 void epad_init()
 {
     //Attach the LCD to the SPI bus
+    ESP_LOGI(TAG, "Panel: %s (%ux%u, %u bpp)", epd_panel.name,
+             epd_panel.width, epd_panel.height, epd_panel.bpp);
     epd_init();
     // epd_clear(EPD_4IN0E_WHITE);
     // vTaskDelay(pdMS_TO_TICKS(500));
 
     UBYTE *Image;
-    // // UWORD Imagesize = ((EPD_4IN0E_WIDTH % 2 == 0)? (EPD_4IN0E_WIDTH / 2 ): (EPD_4IN0E_WIDTH / 2 + 1)) * EPD_4IN0E_HEIGHT;
+    // // UWORD Imagesize = ((EPD_PANEL_WIDTH % 2 == 0)? (EPD_PANEL_WIDTH / 2 ): (EPD_PANEL_WIDTH / 2 + 1)) * EPD_PANEL_HEIGHT;
     // // Image = (UBYTE *)malloc(Imagesize/6);
-    // // Paint_NewImage(Image, EPD_4IN0E_WIDTH/2, EPD_4IN0E_HEIGHT/3, 0, EPD_4IN0E_WHITE);
+    // // Paint_NewImage(Image, EPD_PANEL_WIDTH/2, EPD_PANEL_HEIGHT/3, 0, EPD_4IN0E_WHITE);
     // UWORD Imagesize = 200 * 200;
     // Image = (UBYTE *)malloc(Imagesize);
     // Paint_NewImage(Image, 200, 200, 0, EPD_4IN0E_WHITE);    
@@ -750,66 +1132,109 @@ void epad_init()
     // Paint_DrawString_EN(145, 140, "Waveshare", &Font16, EPD_4IN0E_BLACK, EPD_4IN0E_WHITE);
     // epd_displaypart(Image, 100, 150, 200, 200);
 
-    size_t Imagesize = ((EPD_4IN0E_WIDTH % 2 == 0)? (EPD_4IN0E_WIDTH / 2 ): (EPD_4IN0E_WIDTH / 2 + 1)) * EPD_4IN0E_HEIGHT;
-    Image = (UBYTE *)malloc(Imagesize);
-    Paint_NewImage(Image, EPD_4IN0E_WIDTH, EPD_4IN0E_HEIGHT, ROTATE_0, EPD_4IN0E_WHITE);
+    Image = (UBYTE *)malloc(EPD_PANEL_FRAME_SIZE);
+    Paint_NewImage(Image, EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT, ROTATE_0, EPD_4IN0E_WHITE);
     Paint_SetScale(6);
     Paint_SelectImage(Image);
     Paint_Clear(EPD_4IN0E_WHITE);
     epd_display(Image);
     // vTaskDelay(pdMS_TO_TICKS(5000));
-    // epd_displaypart(Image, 0, 0, EPD_4IN0E_WIDTH, EPD_4IN0E_HEIGHT);
+    // epd_displaypart(Image, 0, 0, EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT);
     epd_sleep();
 
     free(Image);
     vTaskDelay(pdMS_TO_TICKS(500));
 }
 
-int get_png_file_list(char **out_list, int max_count)
+// 슬라이드쇼 상태 (딥슬립 중에도 RTC 메모리에 유지)
+// 사진 목록은 SD 카드의 인덱스(photo_index)에서 fseek 한 번으로 읽고,
+// 여기에는 마지막으로 표시한 순번/이름과 그때의 시각, 인덱스 세대를 남긴다.
+// 다음 표시는 마지막 순번에서 (지난 시간 / 지금의 표시 간격)만큼 나아간다. 간격은 전원에 따라
+// 다르므로 (USB 30초, 배터리 60초) 주기 번호가 아니라 시각을 남겨야 전원이 바뀌어도 맞다.
+// 그 사이 사진이 추가/삭제되어
+// 세대가 바뀌었으면 (삭제는 마지막 레코드를 빈자리로 옮기므로 순번이 바뀔 수 있다)
+// 마지막 사진을 이름으로 다시 찾아 그 자리에서 이어 간다.
+#define SLIDESHOW_MAGIC 0x53484f57  // "SHOW"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;    // 마지막 표시 때의 인덱스 세대
+    int64_t shown_at;       // 마지막 표시 시각 (RTC 초)
+    int index;              // 마지막으로 표시한 순번
+    char name[PHOTO_INDEX_NAME_LEN];    // 마지막으로 표시한 파일 이름
+} slideshow_state_t;
+
+static RTC_DATA_ATTR slideshow_state_t s_slideshow;
+
+// 마지막 표시 위치에서 이어 갈 다음 순번. 상태가 없으면 -1
+// 한 번 고를 때마다 새 슬라이드이므로 적어도 한 장은 나아간다 (간격보다 조금 일찍 깨어나도).
+static int slideshow_next_index(time_t now_sec, int interval_sec, int count)
 {
-    DIR *dir = opendir(MOUNT_POINT);
-    if (!dir) {
-        ESP_LOGE(TAG, "Failed to open directory: %s", MOUNT_POINT);
-        return 0;
+    if (s_slideshow.magic != SLIDESHOW_MAGIC || now_sec < s_slideshow.shown_at) {
+        return -1;      // 전원이 나갔거나 RTC 시각이 되돌아감
+    }
+
+    int base = s_slideshow.index;
+    if (s_slideshow.generation != photo_index_generation()) {
+        int found = photo_index_find(s_slideshow.name);
+        ESP_LOGI(TAG, "Photo set changed (generation %lu -> %lu): last photo %s",
+                 (unsigned long)s_slideshow.generation, (unsigned long)photo_index_generation(),
+                 found < 0 ? "removed" : "moved");
+        if (found >= 0) {
+            base = found;
+        } else {
+            base--;     // 지워진 자리에 다른 사진이 들어왔으므로 그 사진부터
+        }
     }
 
-    struct dirent *entry;
-    int count = 0;
+    uint64_t elapsed = (uint64_t)(now_sec - s_slideshow.shown_at);
+    uint64_t step = (elapsed + interval_sec / 2) / interval_sec;
+    if (step == 0) {
+        step = 1;
+    }
+    return (int)(((uint64_t)(base + count) + step % count) % count);
+}
 
-    while ((entry = readdir(dir)) != NULL) {
-        // entry->d_name: 파일/폴더 이름
-        if (entry->d_type == DT_REG) { // DT_REG: 일반 파일
-            // 확장자가 .png인지 확인
-            // const char *fname = entry->d_name;
-            char fname[248]; // +1 for null-terminator
-            strncpy(fname, entry->d_name, 247);
-            fname[247] = '\0';
-            const char *ext = strrchr(fname, '.'); // 뒤에서부터 '.' 검색
-            if (ext && strcasecmp(ext, ".png") == 0) {
-                // PNG 파일이면 목록에 저장
-                if (count < max_count) {
-                    // 메모리 할당 후 파일 경로를 저장해둔다
-                    // ex) /sdcard/image.png 처럼 full path로 저장
-                    char full_path[256];
-                    snprintf(full_path, sizeof(full_path), "/sdcard/%s", fname);
-
-                    out_list[count] = strdup(full_path); 
-                    // strdup()는 내부적으로 malloc()을 사용하므로 
-                    // 사용 후 free() 해야 함.
-
-                    ESP_LOGI(TAG, "Found PNG: %s", out_list[count]);
-                    count++;
-                } else {
-                    ESP_LOGW(TAG, "Max file count reached.");
-                    break;
-                }
-            }
+// now_sec에 표시할 슬라이드의 경로를 out_path에 채운다. interval_sec는 지금 전원의 표시 간격.
+// 여유 공간 스탬프로는 잡히지 않는 바깥 변경(같은 클러스터 수만큼 추가와 삭제 등)으로
+// 고른 파일이 없으면 인덱스를 다시 만들고 한 번 더 고른다.
+bool slideshow_pick(time_t now_sec, int interval_sec, char *out_path, size_t out_len, uint32_t *src_hash)
+{
+    int count, index;
+    photo_index_record_t rec;
+    for (int attempt = 0; ; attempt++) {
+        count = photo_index_count();
+        if (count <= 0) {
+            return false;
         }
-    }
 
-    closedir(dir);
-    return count;    
+        index = slideshow_next_index(now_sec, interval_sec, count);
+        if (index < 0) {
+            index = (uint64_t)now_sec / interval_sec % count;
+        }
 
+        if (!photo_index_get(index, &rec) || !photo_index_path(&rec, out_path, out_len)) {
+            return false;
+        }
+        struct stat st;
+        if (stat(out_path, &st) == 0) {
+            break;
+        }
+        ESP_LOGW(TAG, "Indexed photo missing: %s", out_path);
+        if (attempt > 0 || !photo_index_rebuild()) {
+            return false;
+        }
+    }
+
+    s_slideshow.magic = SLIDESHOW_MAGIC;
+    s_slideshow.generation = photo_index_generation();
+    s_slideshow.shown_at = now_sec;
+    s_slideshow.index = index;
+    memcpy(s_slideshow.name, rec.name, sizeof(s_slideshow.name));
+    *src_hash = rec.hash;
+    ESP_LOGI(TAG, "interval=%ds, index=%d/%d (%ux%u)",
+             interval_sec, index, count, rec.width, rec.height);
+    return true;
 }
 
 void read_from_sdcard()
@@ -839,6 +1264,168 @@ void setSDCardMODE(bool arg)
     }
 }
 
+// SPIFFS 웹 자산 캐시 정보
+// ETag는 부팅 시 한 번 계산해서 작은 테이블에 보관한다.
+// 빌드 해시가 이름에 들어간 파일(static/js/main.a9f8c9bf.js)은 내용이 바뀌면 이름도 바뀌므로
+// 이름+크기로 ETag를 만들고 1년 동안 캐시하게 한다. 나머지는 내용 해시로 ETag를 만들고
+// 매번 재검증(no-cache)하게 해서 304로 끝나게 한다.
+// Last-Modified는 보내지 않는다. CONFIG_SPIFFS_USE_MTIME은 켜져 있지만 파티션 이미지를
+// 만드는 spiffs_create_partition_image(spiffsgen.py)가 자산의 수정 시각을 기록하지 않아서
+// 플래시로 구운 파일의 st_mtime에는 쓸 만한 값이 없다.
+#define SPIFFS_BASE_PATH "/spiffs"
+
+typedef struct {
+    char path[CONFIG_SPIFFS_OBJ_NAME_LEN];  // "/static/js/main.a9f8c9bf.js"
+    char etag[24];                          // "\"xxxxxxxx-size\""
+    bool immutable;
+} spiffs_asset_t;
+
+static spiffs_asset_t *s_assets = NULL;
+static int s_asset_count = 0;
+
+// 이름에 ".<8자리 이상 16진수>." 가 있으면 빌드 해시가 들어간 파일
+static bool asset_name_is_hashed(const char *name)
+{
+    const char *dot = strchr(name, '.');
+    while (dot) {
+        const char *next = strchr(dot + 1, '.');
+        if (!next) {
+            break;
+        }
+        size_t n = next - dot - 1;
+        bool hex = n >= 8;
+        for (size_t i = 0; hex && i < n; i++) {
+            hex = isxdigit((unsigned char)dot[1 + i]);
+        }
+        if (hex) {
+            return true;
+        }
+        dot = next;
+    }
+    return false;
+}
+
+static uint32_t asset_content_hash(const char *filepath)
+{
+    uint32_t hash = EPD_FNV1A_INIT;
+    FILE *file = fopen(filepath, "rb");
+    if (!file) {
+        return hash;
+    }
+    char buffer[512];
+    size_t read_bytes;
+    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = epd_fnv1a(hash, buffer, read_bytes);
+    }
+    fclose(file);
+    return hash;
+}
+
+void spiffs_assets_init(void)
+{
+    DIR *dir = opendir(SPIFFS_BASE_PATH);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "SPIFFS 디렉토리 열기 실패");
+        return;
+    }
+
+    struct dirent *entry;
+    int count = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        count++;
+    }
+    rewinddir(dir);
+
+    free(s_assets);
+    s_asset_count = 0;
+    s_assets = (spiffs_asset_t *)calloc(count ? count : 1, sizeof(spiffs_asset_t));
+    if (!s_assets) {
+        closedir(dir);
+        return;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    char filepath[sizeof(SPIFFS_BASE_PATH) + CONFIG_SPIFFS_OBJ_NAME_LEN + 1];
+    while ((entry = readdir(dir)) != NULL && s_asset_count < count) {
+        // SPIFFS는 디렉터리가 없고 "static/js/a.js"처럼 이름에 '/'가 들어간다
+        spiffs_asset_t *a = &s_assets[s_asset_count];
+        snprintf(a->path, sizeof(a->path), "/%s", entry->d_name);
+        snprintf(filepath, sizeof(filepath), SPIFFS_BASE_PATH "%s", a->path);
+
+        struct stat st;
+        if (stat(filepath, &st) != 0) {
+            continue;
+        }
+        a->immutable = asset_name_is_hashed(entry->d_name);
+        uint32_t hash = a->immutable
+                      ? epd_fnv1a(EPD_FNV1A_INIT, a->path, strlen(a->path))
+                      : asset_content_hash(filepath);
+        snprintf(a->etag, sizeof(a->etag), "\"%08lx-%lx\"", (unsigned long)hash, (unsigned long)st.st_size);
+        s_asset_count++;
+    }
+    closedir(dir);
+
+    ESP_LOGI(TAG, "SPIFFS 자산 %d개 ETag 계산: %lld ms", s_asset_count,
+             (long long)((esp_timer_get_time() - start_us) / 1000));
+}
+
+static const spiffs_asset_t *spiffs_asset_find(const char *filepath)
+{
+    const char *path = filepath + strlen(SPIFFS_BASE_PATH);
+    for (int i = 0; i < s_asset_count; i++) {
+        if (strcmp(s_assets[i].path, path) == 0) {
+            return &s_assets[i];
+        }
+    }
+    return NULL;
+}
+
+// 빌드 때 만든 <file>.gz가 있고 브라우저가 gzip을 받으면 filepath를 .gz로 바꾼다
+bool spiffs_asset_pick_gzip(http_file_resp_t *resp, char *filepath, size_t size)
+{
+    size_t len = strlen(filepath);
+    if (len + sizeof(".gz") > size) {
+        return false;
+    }
+    strcpy(filepath + len, ".gz");
+    bool have_gz = spiffs_asset_find(filepath) != NULL;
+    filepath[len] = '\0';
+    if (!have_gz) {
+        return false;
+    }
+
+    http_file_set_hdr(resp, "Vary", "Accept-Encoding");
+    char accept[96];
+    if (httpd_req_get_hdr_value_str(resp->req, "Accept-Encoding", accept, sizeof(accept)) != ESP_OK
+        || strstr(accept, "gzip") == NULL) {
+        return false;
+    }
+    strcpy(filepath + len, ".gz");
+    return true;
+}
+
+// 캐시 헤더 설정. If-None-Match가 ETag와 같으면 304를 보내고 true 반환.
+bool spiffs_asset_not_modified(http_file_resp_t *resp, const char *filepath)
+{
+    const spiffs_asset_t *a = spiffs_asset_find(filepath);
+    if (!a) {
+        return false;
+    }
+
+    http_file_set_hdr(resp, "ETag", a->etag);
+    http_file_set_hdr(resp, "Cache-Control",
+                      a->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+
+    char inm[64];
+    if (httpd_req_get_hdr_value_str(resp->req, "If-None-Match", inm, sizeof(inm)) == ESP_OK
+        && strstr(inm, a->etag) != NULL) {
+        httpd_resp_set_status(resp->req, "304 Not Modified");
+        httpd_resp_send(resp->req, NULL, 0);
+        return true;
+    }
+    return false;
+}
+
 // SPIFFS 초기화
 void init_spiffs()
 {
@@ -866,45 +1453,44 @@ void init_spiffs()
 
     ESP_LOGI(TAG, "SPIFFS 마운트 완료 - 총 크기: %d 바이트, 사용량: %d 바이트", total, used);
 
-    // SPIFFS 파일 목록 출력
-    DIR *dir = opendir("/spiffs");
-    if (dir == NULL) {
-        ESP_LOGE(TAG, "SPIFFS 디렉토리 열기 실패");
-        return;
-    }
-    // struct dirent *entry;
-    // ESP_LOGI(TAG, "SPIFFS 파일 목록:");
-    // while ((entry = readdir(dir)) != NULL) {
-    //     ESP_LOGI(TAG, "  %s", entry->d_name);
-    // }
-    closedir(dir);
+    // 웹 자산 ETag 테이블 (요청마다 다시 계산하지 않도록 부팅 시 한 번)
+    spiffs_assets_init();
 }
 
-esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename)
+void set_content_type_from_file(http_file_resp_t *resp, const char *filename)
 {
+    // "<name>.gz": 원래 이름의 형식 + Content-Encoding: gzip
+    char plain[32];
+    if (IS_FILE_EXT(filename, ".gz")) {
+        http_file_set_hdr(resp, "Content-Encoding", "gzip");
+        size_t len = strlen(filename) - 3;
+        size_t keep = MIN(len, sizeof(plain) - 1);  // 확장자 비교에는 끝부분만 있으면 된다
+        memcpy(plain, filename + len - keep, keep);
+        plain[keep] = '\0';
+        filename = plain;
+    }
+
     if (IS_FILE_EXT(filename, ".pdf")) {
-        return httpd_resp_set_type(req, "application/pdf");
+        http_file_set_type(resp, "application/pdf");
     } else if (IS_FILE_EXT(filename, ".html")) {
-        return httpd_resp_set_type(req, "text/html");
+        http_file_set_type(resp, "text/html");
     } else if (IS_FILE_EXT(filename, ".jpeg")) {
-        return httpd_resp_set_type(req, "image/jpeg");
+        http_file_set_type(resp, "image/jpeg");
     } else if (IS_FILE_EXT(filename, ".ico")) {
-        return httpd_resp_set_type(req, "image/x-icon");
-    } else if (IS_FILE_EXT(filename, ".js.gz")) {
-        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-        return httpd_resp_set_type(req, "text/javascript");
-    } else if (IS_FILE_EXT(filename, ".css.gz")) {
-        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-        return httpd_resp_set_type(req, "text/css");
+        http_file_set_type(resp, "image/x-icon");
     } else if (IS_FILE_EXT(filename, ".js")) {
-        return httpd_resp_set_type(req, "text/javascript");
+        http_file_set_type(resp, "text/javascript");
     } else if (IS_FILE_EXT(filename, ".css")) {
-        return httpd_resp_set_type(req, "text/css");
+        http_file_set_type(resp, "text/css");
     } else if (IS_FILE_EXT(filename, ".png")) {
-        return httpd_resp_set_type(req, "image/png");
+        http_file_set_type(resp, "image/png");
+    } else if (IS_FILE_EXT(filename, ".bmp")) {
+        http_file_set_type(resp, "image/bmp");
+    } else if (IS_FILE_EXT(filename, ".json")) {
+        http_file_set_type(resp, "application/json");
+    } else {
+        http_file_set_type(resp, "text/plain");
     }
-
-    return httpd_resp_set_type(req, "text/plain");
 }
 
 const char* get_path_from_uri(char *dest, const char *base_path, const char *uri, size_t destsize)
@@ -934,12 +1520,169 @@ const char* get_path_from_uri(char *dest, const char *base_path, const char *uri
     return dest + base_pathlen;
 }
 
+// JSON 문자열 값 이스케이프 (따옴표/역슬래시/제어 문자)
+static size_t json_escape(char *out, size_t out_len, const char *in, size_t in_len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < in_len && in[i] && n + 7 < out_len; i++) {
+        unsigned char c = (unsigned char)in[i];
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if (c < 0x20) {
+            n += snprintf(out + n, out_len - n, "\\u%04x", c);
+        } else {
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static void upload_log_progress(httpd_req_t *req, size_t remaining, size_t *next_log)
+{
+    size_t done = req->content_len - remaining;
+    if (done >= *next_log) {
+        ESP_LOGI(TAG, "upload: %u / %u KB", (unsigned)(done / 1024), (unsigned)(req->content_len / 1024));
+        *next_log += UPLOAD_LOG_STEP;
+    }
+}
+
+// 받는 대로 같은 태스크에서 파싱/기록. 다 받지 못하면 남은 바이트 수를 돌려준다
+static size_t upload_recv_inline(httpd_req_t *req, multipart_parser *parser)
+{
+    // 수신 버퍼: 한 번의 recv로 lwIP가 쌓아 둔 만큼 가져온다 (PSRAM이어도 됨)
+    char *scratch = (char *)malloc(CONFIG_UPLOAD_RECV_BUF_SIZE);
+    if (!scratch) {
+        ESP_LOGE(TAG, "Failed to allocate upload buffer");
+        return req->content_len;
+    }
+
+    size_t remaining = req->content_len;
+    size_t next_log = UPLOAD_LOG_STEP;
+    while (remaining > 0) {
+        int received = httpd_req_recv(req, scratch, MIN(remaining, CONFIG_UPLOAD_RECV_BUF_SIZE));
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (received <= 0) {
+            ESP_LOGE(TAG, "Failed to receive body");
+            break;
+        }
+
+        multipart_parser_execute(parser, scratch, received);
+        remaining -= received;
+        upload_log_progress(req, remaining, &next_log);
+    }
+    free(scratch);
+    return remaining;
+}
+
+#if CONFIG_UPLOAD_WRITER_TASK
+// 업로드 파이프라인: httpd 태스크는 소켓에서 받아 버퍼 풀에 채우기만 하고,
+// 다른 코어에 고정한 writer 태스크가 파싱/SD 기록/프레임 변환을 한다.
+// 빈 버퍼가 없으면 수신이 멈추고 (back-pressure) TCP 창이 닫혀 송신 측도 기다린다.
+#define UPLOAD_POOL_COUNT    4
+#define UPLOAD_WRITER_STACK  12288      // PNG -> 프레임 변환(libpng)까지 수행
+#define UPLOAD_HTTPD_CORE    0
+#define UPLOAD_WRITER_CORE   1
+
+typedef struct {
+    char *data;
+    int len;                // 0: 본문 끝, <0: 수신 실패
+} upload_chunk_t;
+
+typedef struct {
+    multipart_parser *parser;
+    QueueHandle_t free_q;   // 비어 있는 버퍼
+    QueueHandle_t full_q;   // 받은 데이터 (+ 끝 표시)
+    TaskHandle_t owner;
+} upload_pipe_t;
+
+static void upload_writer_task(void *arg)
+{
+    upload_pipe_t *pipe = (upload_pipe_t *)arg;
+    upload_chunk_t chunk;
+    while (xQueueReceive(pipe->full_q, &chunk, portMAX_DELAY) == pdTRUE && chunk.len > 0) {
+        multipart_parser_execute(pipe->parser, chunk.data, chunk.len);
+        xQueueSend(pipe->free_q, &chunk, portMAX_DELAY);
+    }
+    xTaskNotifyGive(pipe->owner);
+    vTaskDelete(NULL);
+}
+
+static size_t upload_recv_pipelined(httpd_req_t *req, multipart_parser *parser)
+{
+    upload_pipe_t pipe = {
+        .parser = parser,
+        .owner = xTaskGetCurrentTaskHandle(),
+    };
+    char *pool = (char *)malloc(UPLOAD_POOL_COUNT * CONFIG_UPLOAD_RECV_BUF_SIZE);
+    pipe.free_q = xQueueCreate(UPLOAD_POOL_COUNT, sizeof(upload_chunk_t));
+    pipe.full_q = xQueueCreate(UPLOAD_POOL_COUNT + 1, sizeof(upload_chunk_t));
+    if (!pool || !pipe.free_q || !pipe.full_q
+        || xTaskCreatePinnedToCore(upload_writer_task, "upload_writer", UPLOAD_WRITER_STACK, &pipe,
+                                   tskIDLE_PRIORITY + 5, NULL, UPLOAD_WRITER_CORE) != pdPASS) {
+        ESP_LOGW(TAG, "Upload writer task unavailable, receiving inline");
+        if (pipe.free_q) {
+            vQueueDelete(pipe.free_q);
+        }
+        if (pipe.full_q) {
+            vQueueDelete(pipe.full_q);
+        }
+        free(pool);
+        return upload_recv_inline(req, parser);
+    }
+
+    upload_chunk_t chunk;
+    for (int i = 0; i < UPLOAD_POOL_COUNT; i++) {
+        chunk.data = pool + i * CONFIG_UPLOAD_RECV_BUF_SIZE;
+        chunk.len = 0;
+        xQueueSend(pipe.free_q, &chunk, 0);
+    }
+
+    size_t remaining = req->content_len;
+    size_t next_log = UPLOAD_LOG_STEP;
+    int64_t stall_us = 0;
+    while (remaining > 0) {
+        // SD 기록이 밀리면 여기서 빈 버퍼를 기다린다
+        int64_t wait_us = esp_timer_get_time();
+        xQueueReceive(pipe.free_q, &chunk, portMAX_DELAY);
+        stall_us += esp_timer_get_time() - wait_us;
+
+        int received;
+        do {
+            received = httpd_req_recv(req, chunk.data, MIN(remaining, CONFIG_UPLOAD_RECV_BUF_SIZE));
+        } while (received == HTTPD_SOCK_ERR_TIMEOUT);
+        if (received <= 0) {
+            ESP_LOGE(TAG, "Failed to receive body");
+            break;
+        }
+
+        chunk.len = received;
+        xQueueSend(pipe.full_q, &chunk, portMAX_DELAY);   // 풀 크기 + 1이라 막히지 않음
+        remaining -= received;
+        upload_log_progress(req, remaining, &next_log);
+    }
+
+    // 끝 표시를 넣고 writer가 남은 버퍼를 다 쓸 때까지 기다린다
+    chunk.data = NULL;
+    chunk.len = remaining > 0 ? -1 : 0;
+    xQueueSend(pipe.full_q, &chunk, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "upload: receive waited %lld ms for the SD writer", (long long)(stall_us / 1000));
+    vQueueDelete(pipe.free_q);
+    vQueueDelete(pipe.full_q);
+    free(pool);
+    return remaining;
+}
+#endif
+
 // HTTP POST 핸들러
 esp_err_t upload_post_handler(httpd_req_t *req)
 {
     char boundary[MAX_BOUNDARY_LENGTH];
-    char scratch[SCRATCH_BUFSIZE];
-    int received;
 
     // Content-Type 헤더에서 boundary 추출
     if (httpd_req_get_hdr_value_str(req, "Content-Type", boundary, sizeof(boundary)) != ESP_OK) {
@@ -962,29 +1705,76 @@ esp_err_t upload_post_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // 본문 처리
-    size_t remaining = req->content_len;
-    while (remaining > 0) {
-        received = httpd_req_recv(req, scratch, MIN(remaining, SCRATCH_BUFSIZE));
-        if (received <= 0) {
-            ESP_LOGE(TAG, "Failed to receive body");
-            multipart_parser_free(parser);
-            return ESP_FAIL;
-        }
+    // 쓰기 버퍼는 GET 전송 버퍼를 빌린다 (같은 서버 태스크라 겹치지 않음). 섹터 배수로 맞춘다
+    upload_wbuf = (uint8_t *)http_file_buffer(&upload_wbuf_size);
+    upload_wbuf_size = MIN(upload_wbuf_size, SD_ALLOCATION_UNIT) & ~(size_t)(4096 - 1);
+    if (upload_wbuf_size == 0) {
+        upload_wbuf = NULL;
+    }
+    upload_wbuf_len = 0;
 
-        // ESP_LOG_BUFFER_HEXDUMP(__FUNCTION__, &scratch, received, ESP_LOG_INFO);            
+    upload_frames_ready = 0;
+    upload_frames_failed = 0;
+    upload_files_stored = 0;
+    upload_convert_us = 0;
+    upload_file_count = 0;
+    upload_cur = &upload_overflow;
+    int64_t start_us = esp_timer_get_time();
 
-        multipart_parser_execute(parser, scratch, received);
-        remaining -= received;
-        ESP_LOGI(TAG, "remaining: %d", remaining);
-    }
+    // 본문 처리 (PNG 파트는 끝나는 즉시 패널 프레임으로 변환됨)
+#if CONFIG_UPLOAD_WRITER_TASK
+    size_t remaining = upload_recv_pipelined(req, parser);
+#else
+    size_t remaining = upload_recv_inline(req, parser);
+#endif
 
     // 멀티파트 파서 정리
     multipart_parser_free(parser);
+    if (current_file) {             // 중간에 끊긴 파트는 임시 파일째 버린다
+        upload_abort_part("incomplete");
+    }
+    upload_wbuf = NULL;
+    photo_index_touch();            // 일부 파일은 이미 기록됐을 수 있음
+    if (remaining > 0) {
+        return ESP_FAIL;
+    }
 
-    ESP_LOGI(TAG, "File upload complete");
-    httpd_resp_sendstr(req, "File upload successful");
-    return ESP_OK;
+    // 처리량은 요청 전체의 경과 시간 기준. 변환은 기록 태스크(core 1)에서 수신과 겹쳐 돌 수
+    // 있어서 경과 시간에서 빼면 처리량이 부풀려지므로, 변환 시간 합은 따로 보고한다.
+    int64_t xfer_us = esp_timer_get_time() - start_us;
+    double kbps = xfer_us > 0 ? (double)req->content_len * 1000000.0 / 1024.0 / xfer_us : 0.0;
+    ESP_LOGI(TAG, "File upload complete: %u bytes, %lld ms, %.1f KB/s (files: %d/%d, frames ready: %d, failed: %d, convert %lld ms)",
+             (unsigned)req->content_len, (long long)(xfer_us / 1000), kbps,
+             upload_files_stored, upload_file_count,
+             upload_frames_ready, upload_frames_failed, (long long)(upload_convert_us / 1000));
+
+    // 파일별 결과. 하나도 저장하지 못했으면 400
+    if (upload_file_count > 0 && upload_files_stored == 0) {
+        httpd_resp_set_status(req, "400 Bad Request");
+    }
+    httpd_resp_set_type(req, "application/json");
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf),
+                       "{\"files_total\":%d,\"files_ok\":%d,\"frames_ready\":%d,\"frames_failed\":%d,"
+                       "\"bytes\":%u,\"ms\":%lld,\"kbps\":%.1f,\"convert_ms\":%lld,\"files\":[",
+                       upload_file_count, upload_files_stored, upload_frames_ready, upload_frames_failed,
+                       (unsigned)req->content_len, (long long)(xfer_us / 1000), kbps,
+                       (long long)(upload_convert_us / 1000));
+    char name[sizeof(upload_results[0].name) * 2];
+    for (int i = 0; i < MIN(upload_file_count, UPLOAD_MAX_RESULTS); i++) {
+        const upload_result_t *r = &upload_results[i];
+        json_escape(name, sizeof(name), r->name, sizeof(r->name));
+        if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len = snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"status\":\"%s\",\"size\":%lu,\"frame\":%s}",
+                       i ? "," : "", name, r->status, (unsigned long)r->size, r->frame ? "true" : "false");
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
 /* Handler to delete a file from the server */
@@ -995,10 +1785,27 @@ esp_err_t delete_post_handler(httpd_req_t *req)
     // MOUNT_POINT와 삭제할 파일 경로를 결합
     snprintf(filepath, sizeof(filepath), MOUNT_POINT "/%s", req->uri + 8); // "/delete/" 제거
 
+    photo_files_lock();
     if (unlink(filepath) == 0) {
         ESP_LOGI(TAG, "파일 삭제 성공: %s", filepath);
+
+        // 변환해 둔 패널 프레임/미리보기도 같이 삭제하고 인덱스에서 제거
+        char frame_path[256];
+        if (IS_FILE_EXT(filepath, ".png")) {
+            if (epd_frame_path(frame_path, sizeof(frame_path), filepath)) {
+                unlink(frame_path);
+            }
+            if (epd_thumb_path(frame_path, sizeof(frame_path), filepath)) {
+                unlink(frame_path);
+            }
+            photo_index_remove(filepath);
+        } else {
+            photo_index_touch();
+        }
+        photo_files_unlock();
         httpd_resp_sendstr(req, "파일 삭제 성공");
     } else {
+        photo_files_unlock();
         ESP_LOGE(TAG, "파일 삭제 실패: %s", filepath);
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "파일 삭제 실패");
     }
@@ -1010,85 +1817,181 @@ esp_err_t delete_post_handler(httpd_req_t *req)
 esp_err_t http_get_handler(httpd_req_t *req)
 {
     char filepath[64 + 1024];
-    snprintf(filepath, sizeof(filepath), "/spiffs%s", req->uri);
-
-    // 파일 열기
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        ESP_LOGE(TAG, "파일 열기 실패: %s", filepath);
-        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "파일을 찾을 수 없습니다.");
+    if (!get_path_from_uri(filepath, SPIFFS_BASE_PATH, req->uri, sizeof(filepath))) {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "경로가 너무 깁니다.");
         return ESP_FAIL;
     }
 
-    char buffer[512];
-    size_t read_bytes;
-    set_content_type_from_file(req, filepath);
+    http_file_resp_t resp;
+    http_file_resp_init(&resp, req);
 
-    // 파일 내용 전송
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        httpd_resp_send_chunk(req, buffer, read_bytes);
+    // 압축본이 있으면 그쪽을 보낸다 (Content-Encoding은 set_content_type_from_file에서)
+    spiffs_asset_pick_gzip(&resp, filepath, sizeof(filepath));
+
+    // 브라우저 캐시가 최신이면 파일을 열지 않고 304
+    if (spiffs_asset_not_modified(&resp, filepath)) {
+        return ESP_OK;
     }
-    fclose(file);
 
-    // 응답 종료
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    set_content_type_from_file(&resp, filepath);
+    return http_file_send(&resp, filepath);
 }
 
 esp_err_t http_get_index_handler(httpd_req_t *req)
 {
     char filepath[64 + 1024];
-    snprintf(filepath, sizeof(filepath), "/spiffs/index.html");
+    snprintf(filepath, sizeof(filepath), SPIFFS_BASE_PATH "/index.html");
 
-    // 파일 열기
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        ESP_LOGE(TAG, "파일 열기 실패: %s", filepath);
-        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "파일을 찾을 수 없습니다.");
-        return ESP_FAIL;
-    }
+    http_file_resp_t resp;
+    http_file_resp_init(&resp, req);
 
-    char buffer[512];
-    size_t read_bytes;
-    set_content_type_from_file(req, filepath);
+    // 압축본이 있으면 그쪽을 보낸다 (Content-Encoding은 set_content_type_from_file에서)
+    spiffs_asset_pick_gzip(&resp, filepath, sizeof(filepath));
 
-    // 파일 내용 전송
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        httpd_resp_send_chunk(req, buffer, read_bytes);
+    // 브라우저 캐시가 최신이면 파일을 열지 않고 304
+    if (spiffs_asset_not_modified(&resp, filepath)) {
+        return ESP_OK;
     }
-    fclose(file);
 
-    // 응답 종료
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    set_content_type_from_file(&resp, filepath);
+    return http_file_send(&resp, filepath);
 }
 
 esp_err_t http_get_image_handler(httpd_req_t *req)
 {
     char filepath[64 + 1024];
-    snprintf(filepath, sizeof(filepath), "/sdcard%s", req->uri + 6);
+    if (!get_path_from_uri(filepath, MOUNT_POINT, req->uri + 6, sizeof(filepath))) {  // "/image" 제거
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "경로가 너무 깁니다.");
+        return ESP_FAIL;
+    }
 
-    // 파일 열기
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        ESP_LOGE(TAG, "파일 열기 실패: %s", filepath);
-        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "파일을 찾을 수 없습니다.");
+    // 약한 신호에서 끊긴 다운로드를 이어받을 수 있게 Range 허용
+    http_file_resp_t resp;
+    http_file_resp_init(&resp, req);
+    resp.ranges = true;
+    set_content_type_from_file(&resp, filepath);
+    return http_file_send(&resp, filepath);
+}
+
+// GET /api/photos?offset=0&limit=50
+// 인덱스에서 레코드를 몇 개씩 읽어 바로 청크로 보낸다. 전체 목록을 메모리에 만들지 않는다.
+#define PHOTO_LIST_DEFAULT_LIMIT  50
+#define PHOTO_LIST_MAX_LIMIT      500
+#define PHOTO_LIST_BATCH          8
+
+esp_err_t api_photos_get_handler(httpd_req_t *req)
+{
+    int offset = 0;
+    int limit = PHOTO_LIST_DEFAULT_LIMIT;
+
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[16];
+        if (httpd_query_key_value(query, "offset", value, sizeof(value)) == ESP_OK) {
+            offset = atoi(value);
+        }
+        if (httpd_query_key_value(query, "limit", value, sizeof(value)) == ESP_OK) {
+            limit = atoi(value);
+        }
+    }
+    if (offset < 0) {
+        offset = 0;
+    }
+    if (limit <= 0 || limit > PHOTO_LIST_MAX_LIMIT) {
+        limit = PHOTO_LIST_MAX_LIMIT;
+    }
+
+    int total = photo_index_count();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    char buf[1536];
+    int len = snprintf(buf, sizeof(buf),
+                       "{\"total\":%d,\"offset\":%d,\"limit\":%d,\"generation\":%lu,\"photos\":[",
+                       total, offset, limit, (unsigned long)photo_index_generation());
+
+    photo_index_record_t recs[PHOTO_LIST_BATCH];
+    char name[PHOTO_INDEX_NAME_LEN * 2];
+    int sent = 0;
+    while (sent < limit) {
+        int want = MIN(limit - sent, PHOTO_LIST_BATCH);
+        int got = photo_index_read(offset + sent, recs, want);
+        for (int i = 0; i < got; i++) {
+            json_escape(name, sizeof(name), recs[i].name, sizeof(recs[i].name));
+            // 레코드 하나는 최대 ~660바이트 (이름 512 + 나머지): 모자라면 먼저 보낸다
+            if (len > (int)sizeof(buf) - 700) {
+                if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+                    return ESP_FAIL;
+                }
+                len = 0;
+            }
+            len += snprintf(buf + len, sizeof(buf) - len,
+                            "%s{\"name\":\"%s\",\"size\":%lu,\"width\":%u,\"height\":%u,"
+                            "\"rotate\":%u,\"frame\":%s}",
+                            (sent + i) ? "," : "", name, (unsigned long)recs[i].size,
+                            recs[i].width, recs[i].height, recs[i].rotate,
+                            (recs[i].flags & PHOTO_INDEX_FRAME_VALID) ? "true" : "false");
+        }
+        sent += got;
+        if (got < want) {
+            break;
+        }
+    }
+
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
         return ESP_FAIL;
     }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-    char buffer[512];
-    size_t read_bytes;
-    set_content_type_from_file(req, filepath);
+// GET /thumb/<name>.png -> <name>.thumb.bmp
+// 미리보기가 없거나 (이 기능 이전에 변환된 사진) PNG보다 오래됐으면 (교체된 사진의 변환이
+// 실패한 경우) 원본과 맞는 .epd에서 다시 만든다. 다시 만들 수 없는 오래된 미리보기는 지운다.
+esp_err_t http_get_thumb_handler(httpd_req_t *req)
+{
+    char png_path[256];
+    char thumb_path[256];
+    snprintf(png_path, sizeof(png_path), MOUNT_POINT "/%s", req->uri + 7);  // "/thumb/" 제거
+    char *query = strchr(png_path, '?');
+    if (query) {
+        *query = '\0';
+    }
+    if (!epd_thumb_path(thumb_path, sizeof(thumb_path), png_path)) {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "경로가 너무 깁니다.");
+        return ESP_FAIL;
+    }
 
-    // 파일 내용 전송
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        httpd_resp_send_chunk(req, buffer, read_bytes);
+    struct stat st, png_st;
+    bool have_thumb = stat(thumb_path, &st) == 0;
+    bool stale = have_thumb && stat(png_path, &png_st) == 0 && st.st_mtime < png_st.st_mtime;
+    if (!have_thumb || stale) {
+        char frame_path[256];
+        epd_frame_header_t expect, hdr;
+        bool made = false;
+        photo_files_lock();
+        if (frame_expect_for_png(png_path, frame_path, sizeof(frame_path), &expect)) {
+            FILE *frame = epd_frame_open(frame_path, &expect, &hdr);
+            if (frame) {
+                made = epd_thumb_write_from_file(thumb_path, &hdr, frame);
+                fclose(frame);
+            }
+        }
+        if (!made && stale) {
+            ESP_LOGW(TAG, "Removing stale thumbnail: %s", thumb_path);
+            unlink(thumb_path);
+        }
+        if (made || stale) {
+            photo_index_touch();
+        }
+        photo_files_unlock();
     }
-    fclose(file);
 
-    // 응답 종료
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    http_file_resp_t resp;
+    http_file_resp_init(&resp, req);
+    set_content_type_from_file(&resp, thumb_path);
+    http_file_set_hdr(&resp, "Cache-Control", "max-age=86400");
+    return http_file_send(&resp, thumb_path);
 }
 
 // HTTP 서버 시작
@@ -1097,12 +2000,18 @@ void start_web_server()
     httpd_handle_t server = NULL;
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.stack_size = 8192;
+    config.stack_size = 12288;  // 업로드 핸들러에서 PNG 변환(libpng)까지 수행
     config.lru_purge_enable = true;
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.recv_wait_timeout = 30; 
+#if CONFIG_UPLOAD_WRITER_TASK
+    config.core_id = UPLOAD_HTTPD_CORE;  // 업로드 때 SD 기록은 다른 코어의 writer 태스크가 맡는다
+#endif
     ESP_LOGI(TAG, "HTTP 서버 시작 중...");
 
+    // 파일 응답용 버퍼 (서버 태스크 하나가 모든 GET 핸들러에서 같이 쓴다)
+    http_file_init();
+
     if (httpd_start(&server, &config) == ESP_OK) {
         httpd_uri_t get_image_uri = {
             .uri = "/image/*", // 모든 요청 처리
@@ -1129,7 +2038,31 @@ void start_web_server()
             .handler   = delete_post_handler,
             .user_ctx  = NULL    // Pass server data as context
         };
-        httpd_register_uri_handler(server, &file_delete);        
+        httpd_register_uri_handler(server, &file_delete);        
+
+        httpd_uri_t get_thumb_uri = {
+            .uri = "/thumb/*",
+            .method = HTTP_GET,
+            .handler = http_get_thumb_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &get_thumb_uri);
+
+        httpd_uri_t get_photos = {
+            .uri = "/api/photos",
+            .method = HTTP_GET,
+            .handler = api_photos_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &get_photos);
+
+        httpd_uri_t get_bench = {
+            .uri = "/api/bench",
+            .method = HTTP_GET,
+            .handler = http_file_bench_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &get_bench);
 
         httpd_uri_t get_index = {
             .uri = "/", // 모든 요청 처리
@@ -1293,174 +2226,490 @@ time_t get_rtc_time_in_seconds(void)
     return now;
 }
 
-uint8_t get_nearest_epd_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+// 4비트 인덱스 한 행을 패널 버퍼에 바로 기록 (인덱스 코드는 epd_color.h)
+// Rotate 0  : 원본(panel_w x panel_h) 행 y -> 패널 행 y
+// Rotate 90 : 원본(panel_h x panel_w) 행 y -> 패널 열 y, 원본 열 c -> 패널 행 (panel_h - 1 - c)
+// Rotate 90은 보통 epd_rotate(띠 단위 전치)로 처리하고, 여기 행 단위 기록은
+// 띠 버퍼를 못 잡았을 때와 CONFIG_EPD_ROTATE_PER_ROW 비교용으로만 쓴다.
+// (컨트롤러의 0x00 레지스터는 주사 방향 반전만 있어서 90도 회전은 소프트웨어로 한다)
+static void epd_pack_index_row(uint8_t *epd_buffer, const uint8_t *idx, int y, UWORD Rotate)
 {
-    // 알파가 매우 작으면 -> 흰색(또는 배경) 처리
-    if (a < 10) {
-        return EPD_4IN0E_WHITE;
-    }
+    // 패널 크기는 컴파일 시 상수 (epd_panel.h), 2픽셀 = 1바이트 (4비트/픽셀)
+    const uint16_t panel_w = EPD_PANEL_WIDTH;
+    const uint16_t panel_h = EPD_PANEL_HEIGHT;
+    const uint16_t width_4b = EPD_PANEL_STRIDE;
 
-    int best_dist = 99999999;
-    uint8_t best_idx = EPD_4IN0E_WHITE; // 기본값 White
-    for (int i = 0; i < g_color_count; i++) {
-        int dr = (int)r - (int)g_color_table[i].r;
-        int dg = (int)g - (int)g_color_table[i].g;
-        int db = (int)b - (int)g_color_table[i].b;
-        int dist = (dr * dr) + (dg * dg) + (db * db);
-        if (dist < best_dist) {
-            best_dist = dist;
-            best_idx = g_color_table[i].idx4;
+    if (Rotate == 90) {
+        // 원본 한 행이 패널의 한 열이 되므로 nibble 단위로 기록
+        size_t col = y / 2;
+        for (uint16_t c = 0; c < panel_h; c++) {
+            uint8_t epd_col = idx[c];
+
+            size_t idx_4b = (size_t)(panel_h - 1 - c) * width_4b + col;
+            if ((y & 1) == 0) {
+                // 짝수 열 -> 상위 nibble
+                epd_buffer[idx_4b] = (epd_col << 4) | (epd_buffer[idx_4b] & 0x0F);
+            } else {
+                // 홀수 열 -> 하위 nibble
+                epd_buffer[idx_4b] = (epd_buffer[idx_4b] & 0xF0) | (epd_col & 0x0F);
+            }
+        }
+    } else {
+        // 한 행이 그대로 패널 한 행이므로 2픽셀씩 묶어 바이트 단위로 기록
+        uint8_t *dst = epd_buffer + (size_t)y * width_4b;
+        for (uint16_t x = 0; x < panel_w; x += 2) {
+            uint8_t hi = idx[x];
+            uint8_t lo = (x + 1 < panel_w) ? idx[x + 1] : EPD_4IN0E_WHITE;
+            dst[x / 2] = (hi << 4) | lo;
         }
     }
-    return best_idx;
-}
-
-void epad_disp_png(uint8_t *image, UWORD Rotate) 
-{
-    // Rotate는 
-    /*
-    #define ROTATE_0            0
-    #define ROTATE_90           90
-    */
-    // 이미지는 400, 600이 기본이다.
-    // RGBA 픽셀 데이터를 4bit 인덱스 컬러로 변경하는 코드
-    // 인덱스 코드는
-    /*
-    #define EPD_4IN0E_BLACK   0x0   /// 000
-    #define EPD_4IN0E_WHITE   0x1   /// 001
-    #define EPD_4IN0E_YELLOW  0x2   /// 010
-    #define EPD_4IN0E_RED     0x3   /// 011
-    #define EPD_4IN0E_BLUE    0x5   /// 101
-    #define EPD_4IN0E_GREEN   0x6   /// 110
-    */
-
-    uint16_t panel_w = EPD_4IN0E_WIDTH;   // 400
-    uint16_t panel_h = EPD_4IN0E_HEIGHT;  // 600
-
-    // 만약 회전이 90도라면 width<->height 뒤집힘
-    // (실제로는 e-Paper 컨트롤러가 지원하는 Rotate 레지스터를 쓸 수도 있지만
-    //  여기서는 소프트웨어적으로 픽셀 재배치만 가정)
+}
+
+// PNG 행 -> 패널 버퍼 변환기: 디더링 상태와 인덱스 행 버퍼를 묶어 둔다
+typedef struct {
+    uint8_t *epd_buffer;
+    UWORD Rotate;
+    epd_dither_t dither;
+    uint8_t *idx_row;   // 픽셀당 1바이트 4비트 인덱스
+    epd_rotate_t rot;   // Rotate 90: rot.strip이 NULL이면 행 단위 기록
+} epd_row_converter_t;
+
+static bool epd_row_converter_init(epd_row_converter_t *cv, uint8_t *epd_buffer, UWORD Rotate,
+                                   int width, epd_dither_mode_t dither)
+{
+    cv->epd_buffer = epd_buffer;
+    cv->Rotate = Rotate;
+    cv->idx_row = (uint8_t *)malloc(width);
+    if (!cv->idx_row) {
+        ESP_LOGE(TAG, "Failed to allocate index row");
+        return false;
+    }
+#if !CONFIG_EPD_ROTATE_PER_ROW
     if (Rotate == 90) {
-        uint16_t width_4b = (EPD_4IN0E_WIDTH % 2 == 0) ? (EPD_4IN0E_WIDTH / 2) : (EPD_4IN0E_WIDTH / 2 + 1);
-        size_t buf_size = width_4b * EPD_4IN0E_HEIGHT;
+        // 띠 버퍼는 캐시를 거치지 않는 내부 RAM에 둔다
+        size_t strip_size = epd_rotate_strip_size(EPD_PANEL_HEIGHT, EPD_ROTATE_STRIP_ROWS);
+        uint8_t *strip = heap_caps_malloc(strip_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (strip) {
+            epd_rotate_init(&cv->rot, epd_buffer, EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT,
+                            strip, EPD_ROTATE_STRIP_ROWS);
+        } else {
+            ESP_LOGW(TAG, "No internal RAM for rotate strip (%u bytes), writing per row",
+                     (unsigned)strip_size);
+        }
+    }
+#endif
+    // 디더링은 원본 행 순서(회전 전)로 진행
+    return epd_dither_init(&cv->dither, dither, width);
+}
+
+static void epd_row_converter_free(epd_row_converter_t *cv)
+{
+    epd_dither_free(&cv->dither);
+    free(cv->idx_row);
+    cv->idx_row = NULL;
+    free(cv->rot.strip);
+    cv->rot.strip = NULL;
+}
+
+static void epd_row_converter_put(epd_row_converter_t *cv, const uint8_t *rgba_row, int y)
+{
+    epd_dither_row(&cv->dither, rgba_row, y, cv->idx_row);
+    if (cv->rot.strip) {
+        epd_rotate_put(&cv->rot, cv->idx_row, y);
+    } else {
+        epd_pack_index_row(cv->epd_buffer, cv->idx_row, y, cv->Rotate);
+    }
+}
 
-        uint8_t *epd_buffer = (uint8_t *)malloc(buf_size);
-        if (!epd_buffer) {
-            ESP_LOGE("EPD", "epad_disp_png: Failed to allocate epd_buffer");
-            return;
+// 파일 이름 태그로 이미지별 디더링 선택
+//   xxx.fs.png    : Floyd-Steinberg
+//   xxx.bayer.png : Bayer (ordered)
+//   xxx.none.png  : 디더링 없음
+// 태그가 없으면 Kconfig 기본값 (기본은 디더링 없음: 업로드 페이지가 이미 디더링한 사진을 다시 디더링하지 않는다)
+epd_dither_mode_t dither_mode_for_file(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    if (ext) {
+        const char *p = ext;
+        while (p > path && *(p - 1) != '.' && *(p - 1) != '/') {
+            p--;
         }
-        // epd_buffer 초기화
-        memset(epd_buffer, 0x11, buf_size);
-
-        for (uint16_t y = 0; y < EPD_4IN0E_WIDTH; y++) {
-            for (uint16_t x = 0; x < EPD_4IN0E_HEIGHT; x++) {
-                // RGBA8888에서 픽셀 위치 계산
-                size_t idx_rgba = (y * EPD_4IN0E_HEIGHT + (EPD_4IN0E_HEIGHT - 1 - x)) * 4;
-                uint8_t r = image[idx_rgba + 0];
-                uint8_t g = image[idx_rgba + 1];
-                uint8_t b = image[idx_rgba + 2];
-                uint8_t a = image[idx_rgba + 3];
-
-                // e-Paper용 4비트 색상 값 계산
-                uint8_t epd_col = get_nearest_epd_color(r, g, b, a);
-
-                // epd_buffer에 2픽셀당 1바이트로 저장
-                size_t idx_4b = (x * width_4b) + (y / 2);
-                if ((y & 1) == 0) {
-                    // 짝수 x -> 상위 nibble
-                    epd_buffer[idx_4b] = (epd_col << 4) | (epd_buffer[idx_4b] & 0x0F);
-                } else {
-                    // 홀수 x -> 하위 nibble
-                    epd_buffer[idx_4b] = (epd_buffer[idx_4b] & 0xF0) | (epd_col & 0x0F);
-                }
+        if (p > path && *(p - 1) == '.') {
+            size_t len = ext - p;
+            if (len == 2 && strncasecmp(p, "fs", len) == 0) {
+                return EPD_DITHER_FLOYD_STEINBERG;
+            } else if (len == 5 && strncasecmp(p, "bayer", len) == 0) {
+                return EPD_DITHER_ORDERED;
+            } else if (len == 4 && strncasecmp(p, "none", len) == 0) {
+                return EPD_DITHER_NONE;
             }
         }
-        epd_init();
-        epd_display(epd_buffer);
-        free(epd_buffer);
+    }
+#if CONFIG_EPD_DITHER_DEFAULT_FS
+    return EPD_DITHER_FLOYD_STEINBERG;
+#elif CONFIG_EPD_DITHER_DEFAULT_BAYER
+    return EPD_DITHER_ORDERED;
+#else
+    return EPD_DITHER_NONE;
+#endif
+}
+
+// libpng 읽기 콜백: 읽은 바이트로 원본 해시를 같이 계산 (카드 리더기로 복사해 넣은 파일처럼
+// 업로드 때 해시를 얻지 못한 파일만. 변환이 어차피 파일 전체를 읽으므로 다시 읽지 않는다)
+typedef struct {
+    FILE *fp;
+    uint32_t hash;
+} png_src_t;
 
+static void png_src_read(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    png_src_t *src = (png_src_t *)png_get_io_ptr(png_ptr);
+    if (fread(data, 1, length, src->fp) != length) {
+        png_error(png_ptr, "Read error");
     }
-    else {
+    src->hash = epd_fnv1a(src->hash, data, length);
+}
 
-        // e-Paper는 2픽셀 = 1바이트 (4비트/픽셀)
-        // 가로 픽셀이 짝수이면 w/2, 홀수이면 w/2+1
-        uint16_t width_4b = (panel_w % 2 == 0) ? (panel_w / 2) : (panel_w / 2 + 1);
-        size_t   buf_size = width_4b * panel_h;
+// 파일 나머지 부분(IEND 등 libpng가 읽지 않은 꼬리)을 해시에 반영
+static uint32_t png_src_hash_rest(png_src_t *src, uint8_t *buf, size_t buf_len)
+{
+    size_t n;
+    while ((n = fread(buf, 1, buf_len, src->fp)) > 0) {
+        src->hash = epd_fnv1a(src->hash, buf, n);
+    }
+    return src->hash;
+}
 
-        // 변환 후 저장할 버퍼
-        // 예: 400x600 => (400/2)x600 = 200x600 = 120,000 바이트
-        uint8_t *epd_buffer = (uint8_t *)malloc(buf_size);
-        if (!epd_buffer) {
-            ESP_LOGE("EPD", "epad_disp_png: Failed to allocate epd_buffer");
-            return;
-        }
-        memset(epd_buffer, 0x11, buf_size);
-
-        for (uint16_t y = 0; y < panel_h; y++) {
-            for (uint16_t x = 0; x < panel_w; x++) {
-                // RGBA 인덱스 계산
-                // 회전이 90도면 소프트웨어 매핑
-                uint16_t src_x = x;
-                uint16_t src_y = y;
-                if (Rotate == 90) {
-                    // 90도 회전 -> 원본 이미지에서 (x,y)는 (panel_h-1-y, x)
-                    src_x = panel_h - 1 - y;
-                    src_y = x;
-                }
-                // RGBA8888에서 픽셀 위치
-                //   => (src_y*(panel_w) + src_x)*4
-                //   (단, 여기서는 실제 PNG 해상도가 panel_w×panel_h 라고 가정)
-                size_t idx_rgba = (src_y * panel_w + src_x) * 4;
-                uint8_t r = image[idx_rgba + 0];
-                uint8_t g = image[idx_rgba + 1];
-                uint8_t b = image[idx_rgba + 2];
-                uint8_t a = image[idx_rgba + 3];
-
-                // e-Paper 4비트 인덱스
-                uint8_t epd_col = get_nearest_epd_color(r, g, b, a);
-
-                // epd_buffer에 2픽셀당 1바이트로 저장
-                // ex) x=0 => 상위 nibble, x=1 => 하위 nibble
-                // (x/2) 번째 바이트의 ( (x%2)==0 => 상위 4비트 ) or (하위 4비트)
-                size_t idx_4b = (y * width_4b) + (x / 2); 
-                if ((x & 1) == 0) {
-                    // 짝수 x -> 상위 nibble
-                    epd_buffer[idx_4b] = (epd_col << 4) | (epd_buffer[idx_4b] & 0x0F);
-                } else {
-                    // 홀수 x -> 하위 nibble
-                    epd_buffer[idx_4b] = (epd_buffer[idx_4b] & 0xF0) | (epd_col & 0x0F);
-                }
-            }
+// 인터레이스 PNG는 행 단위 스트리밍이 불가능하므로 전체 RGBA 디코딩 후 행 단위로 변환
+static bool png_decode_to_epd_full(const char *filename, uint8_t *epd_buffer, UWORD *Rotate,
+                                   epd_dither_mode_t dither, uint32_t *src_hash)
+{
+    uint8_t *image_data = NULL;
+    int width = 0, height = 0;
+
+    if (!read_png_file(filename, &image_data, &width, &height)) {
+        return false;
+    }
+
+    bool ok = true;
+    if (width == EPD_PANEL_WIDTH && height == EPD_PANEL_HEIGHT) {
+        *Rotate = ROTATE_0;
+    } else if (width == EPD_PANEL_HEIGHT && height == EPD_PANEL_WIDTH) {
+        *Rotate = ROTATE_90;
+    } else {
+        ESP_LOGE(TAG, "Unsupported PNG size: %s (%dx%d)", filename, width, height);
+        ok = false;
+    }
+
+    epd_row_converter_t cv = { 0 };
+    if (ok) {
+        ok = epd_row_converter_init(&cv, epd_buffer, *Rotate, width, dither);
+    }
+    for (int y = 0; ok && y < height; y++) {
+        epd_row_converter_put(&cv, image_data + (size_t)y * width * 4, y);
+    }
+    epd_row_converter_free(&cv);
+    free(image_data);
+
+    // 드문 경로라 해시는 파일을 한 번 더 읽어서 구한다
+    if (ok && src_hash) {
+        FILE *fp = fopen(filename, "rb");
+        uint8_t buf[512];
+        png_src_t src = { .fp = fp, .hash = EPD_FNV1A_INIT };
+        *src_hash = fp ? png_src_hash_rest(&src, buf, sizeof(buf)) : 0;
+        if (fp) {
+            fclose(fp);
         }
-        epd_init();
-        epd_display(epd_buffer);
-        free(epd_buffer);
     }
+    return ok;
+}
+
+static void png_row_buffers_free(uint8_t *row, epd_row_converter_t *cv)
+{
+    epd_row_converter_free(cv);
+    free(cv);
+    free(row);
+}
+
+// PNG를 행 단위로 디코딩하면서 바로 4비트 패널 버퍼로 변환
+// RGBA 전체 버퍼(4.0"에서 960KB) 대신 한 행(최대 EPD_PANEL_MAX_SIDE*4 바이트)만 사용한다.
+// epd_buffer는 패널 크기(EPD_PANEL_FRAME_SIZE, 4.0"에서 120,000 바이트)이며 호출자가 0x11(흰색)로 초기화해 둔다.
+// Rotate에는 이미지 방향에 따라 ROTATE_0 또는 ROTATE_90이 설정된다.
+// dither는 행 단위 디더링 방식 (오차 확산도 두 줄 버퍼만 사용)
+// src_hash가 NULL이 아니면 원본 파일 전체의 FNV-1a 해시를 돌려준다.
+bool png_decode_to_epd(const char *filename, uint8_t *epd_buffer, UWORD *Rotate,
+                       epd_dither_mode_t dither, uint32_t *src_hash)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    // 파일 오픈
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to open file: %s", filename);
+        return false;
+    }
+
+    // PNG 시그니처(8바이트) 확인
+    uint8_t header[8];
+    if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8)) {
+        ESP_LOGE(TAG, "Not a valid PNG file: %s", filename);
+        fclose(fp);
+        return false;
+    }
+    png_src_t src = { .fp = fp, .hash = epd_fnv1a(EPD_FNV1A_INIT, header, 8) };
+
+    // 변환 후 한 행은 RGBA 4바이트 x 최대 가로 픽셀
+    // 변환기는 setjmp 이후에도 값이 유지되도록 힙에 둔다
+    uint8_t *row = (uint8_t *)malloc(EPD_PANEL_MAX_SIDE * 4);
+    epd_row_converter_t *cv = (epd_row_converter_t *)calloc(1, sizeof(epd_row_converter_t));
+    if (!row || !cv) {
+        ESP_LOGE(TAG, "Failed to allocate PNG row buffer");
+        free(row);
+        free(cv);
+        fclose(fp);
+        return false;
+    }
+
+    // libpng 구조체 생성
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr) {
+        ESP_LOGE(TAG, "png_create_read_struct failed");
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        ESP_LOGE(TAG, "png_create_info_struct failed");
+        png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    // libpng 에러 처리를 위한 setjmp
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        ESP_LOGE(TAG, "Error during PNG read");
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    // 해시를 이미 알면 (업로드) 그냥 읽고, 모르면 읽으면서 같이 계산
+    if (src_hash) {
+        png_set_read_fn(png_ptr, &src, png_src_read);
+    } else {
+        png_init_io(png_ptr, fp);
+    }
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    int width  = png_get_image_width(png_ptr, info_ptr);
+    int height = png_get_image_height(png_ptr, info_ptr);
+    int color_type = png_get_color_type(png_ptr, info_ptr);
+    int bit_depth  = png_get_bit_depth(png_ptr, info_ptr);
+
+    if (width == EPD_PANEL_WIDTH && height == EPD_PANEL_HEIGHT) {
+        *Rotate = ROTATE_0;
+    } else if (width == EPD_PANEL_HEIGHT && height == EPD_PANEL_WIDTH) {
+        *Rotate = ROTATE_90;
+    } else {
+        ESP_LOGE(TAG, "Unsupported PNG size: %s (%dx%d)", filename, width, height);
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE) {
+        ESP_LOGW(TAG, "Interlaced PNG, falling back to full decode: %s", filename);
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return png_decode_to_epd_full(filename, epd_buffer, Rotate, dither, src_hash);
+    }
+
+    // read_png_file()과 동일한 RGBA8888 변환 설정
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if ((color_type == PNG_COLOR_TYPE_GRAY) && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+        png_set_tRNS_to_alpha(png_ptr);
+    }
+    if (bit_depth == 16) {
+        png_set_strip_16(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_RGB ||
+        color_type == PNG_COLOR_TYPE_GRAY ||
+        color_type == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
+    }
+    png_read_update_info(png_ptr, info_ptr);
+
+    if (png_get_rowbytes(png_ptr, info_ptr) != (size_t)width * 4) {
+        ESP_LOGE(TAG, "Unexpected PNG row size: %s", filename);
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    if (!epd_row_converter_init(cv, epd_buffer, *Rotate, width, dither)) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        png_row_buffers_free(row, cv);
+        fclose(fp);
+        return false;
+    }
+
+    // 한 행씩 디코딩 -> 즉시 변환
+    for (int y = 0; y < height; y++) {
+        png_read_row(png_ptr, row, NULL);
+        epd_row_converter_put(cv, row, y);
+    }
+    if (src_hash) {
+        *src_hash = png_src_hash_rest(&src, row, EPD_PANEL_MAX_SIDE * 4);
+    }
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+    png_row_buffers_free(row, cv);
+    fclose(fp);
+
+    ESP_LOGI(TAG, "PNG streamed: %s (%dx%d, rotate %d, dither %s) in %lld ms", filename, width, height,
+             *Rotate, epd_dither_mode_name(dither), (long long)((esp_timer_get_time() - start_us) / 1000));
+    return true;
+}
+
+// 4비트 패널 프레임을 화면에 표시 (초기화 -> 전송/갱신 -> 슬립)
+void epad_disp_frame(const uint8_t *epd_buffer)
+{
+    epd_init();
+    epd_display(epd_buffer);
     epd_sleep();
 }
- 
-void display_png_file(const char *file_path)
+
+// 캐시된 .epd 프레임이 유효하면 파일에서 바로 패널 메모리로 전송 (libpng/zlib/RGBA 버퍼 없음)
+// 성공하면 패널은 켜진 채로 true (갱신은 호출자가 사진 잠금을 푼 뒤에 한다).
+// 읽다가 실패하면 패널을 재우고 캐시 파일을 지운 뒤 false (호출자가 PNG 변환으로 넘어감)
+static bool load_cached_frame(const char *frame_path, const epd_frame_header_t *expect)
+{
+    FILE *fp = epd_frame_open(frame_path, expect, NULL);
+    if (!fp) {
+        return false;
+    }
+
+    ESP_LOGI("DISPLAY", "Using cached frame: %s", frame_path);
+    epd_init();
+    esp_err_t err = epd_load_stream(epd_fill_from_file, fp, expect->data_size);
+    fclose(fp);
+
+    if (err != ESP_OK) {
+        epd_sleep();
+        ESP_LOGW("DISPLAY", "Cached frame unreadable, removing: %s", frame_path);
+        unlink(frame_path);     // 레코드는 뒤이은 PNG 변환이 갱신한다
+        return false;
+    }
+    return true;
+}
+
+// PNG -> 4비트 패널 프레임 변환 후 .epd 캐시로 저장
+// epd_buffer는 패널 크기, hdr에는 원본 정보/회전이 채워진다.
+// src_hash는 업로드가 받으면서 구한 원본 해시. 0이면 (카드 리더기로 넣은 파일) 디코딩하면서 구한다.
+bool convert_png_to_frame(const char *png_path, uint8_t *epd_buffer, size_t buf_size, epd_frame_header_t *hdr,
+                          uint32_t src_hash)
+{
+    struct stat st;
+    if (stat(png_path, &st) != 0) {
+        ESP_LOGE(TAG, "File not found: %s", png_path);
+        return false;
+    }
+
+    epd_dither_mode_t dither = dither_mode_for_file(png_path);
+    epd_frame_header_init(hdr, EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT, buf_size, &st, dither);
+
+    epd_color_lut_init();   // 빠른 깨어남 경로에서는 여기서 처음 생성됨
+    memset(epd_buffer, 0x11, buf_size);
+    UWORD Rotate = ROTATE_0;
+    if (!png_decode_to_epd(png_path, epd_buffer, &Rotate, dither, src_hash ? NULL : &src_hash)) {
+        return false;
+    }
+    hdr->rotate = (uint8_t)Rotate;
+    hdr->src_hash = src_hash;
+
+    char frame_path[256];
+    bool cached = epd_frame_path(frame_path, sizeof(frame_path), png_path)
+               && epd_frame_write(frame_path, hdr, epd_buffer);
+
+    // 갤러리 미리보기도 같은 프레임에서 바로 만든다 (PNG 재디코딩 없음)
+    char thumb_path[256];
+    if (epd_thumb_path(thumb_path, sizeof(thumb_path), png_path)) {
+        epd_thumb_write_from_frame(thumb_path, hdr, epd_buffer);
+    }
+    photo_index_update_file(png_path, cached ? hdr : NULL, src_hash);
+    return true;
+}
+
+// PNG 경로에 대응하는 .epd 경로와, 캐시가 유효하려면 맞아야 할 헤더 값
+bool frame_expect_for_png(const char *png_path, char *frame_path, size_t path_len, epd_frame_header_t *expect)
+{
+    size_t buf_size = EPD_PANEL_FRAME_SIZE;
+
+    struct stat st;
+    if (stat(png_path, &st) != 0 || !epd_frame_path(frame_path, path_len, png_path)) {
+        return false;
+    }
+    epd_frame_header_init(expect, EPD_PANEL_WIDTH, EPD_PANEL_HEIGHT, buf_size, &st,
+                          dither_mode_for_file(png_path));
+    return true;
+}
+
+// src_hash는 인덱스가 아는 원본 해시 (모르면 0). .epd 캐시는 해시까지 맞아야 쓴다.
+void display_png_file(const char *file_path, uint32_t src_hash)
 {
-    // TODO: 실제 PNG 디코딩 & 디스플레이 장치에 출력
-    // 예: lodepng + e-Paper 드라이버
     ESP_LOGI("DISPLAY", "Displaying: %s", file_path);
 
-    uint8_t *image_data = NULL;
-    int width = 0, height = 0;
+    // 예: 4.0" 400x600 => (400/2)x600 = 200x600 = 120,000 바이트
+    size_t buf_size = EPD_PANEL_FRAME_SIZE;
+
+    // 파일을 읽고 쓰는 동안만 사진 잠금을 잡는다. 오래 걸리는 패널 갱신은 잠금 밖에서
+    // (업로드가 갱신 시간 동안 멈추지 않도록)
+    photo_files_lock();
+
+    // 1) 원본과 일치하는 .epd 캐시가 있으면 그대로 표시
+    char frame_path[256];
+    epd_frame_header_t expect;
+    bool have_expect = frame_expect_for_png(file_path, frame_path, sizeof(frame_path), &expect);
+    expect.src_hash = src_hash;
+    if (have_expect && load_cached_frame(frame_path, &expect)) {
+        photo_files_unlock();
+        epd_turnondisplay();
+        epd_sleep();
+        return;
+    }
 
-    if (read_png_file(file_path, &image_data, &width, &height)) {
-        ESP_LOGI("MAIN", "PNG load success! w=%d, h=%d", width, height);
-        // image_data로부터 RGBA 픽셀 데이터를 활용
-        // 예: LCD에 뿌리거나, 추가 처리 등을 수행
-        if (width == EPD_4IN0E_WIDTH && height == EPD_4IN0E_HEIGHT) {
-            epad_disp_png(image_data, 0);
-        } else if (width == EPD_4IN0E_HEIGHT && height == EPD_4IN0E_WIDTH) {
-            epad_disp_png(image_data, 90);
-        }
+    // 2) 없으면 PNG 변환 -> 캐시 저장 -> 표시
+    uint8_t *epd_buffer = (uint8_t *)malloc(buf_size);
+    if (!epd_buffer) {
+        photo_files_unlock();
+        ESP_LOGE("EPD", "display_png_file: Failed to allocate epd_buffer");
+        return;
+    }
 
-        // 사용 끝나면 free() 호출
-        free(image_data);
-    }    
+    epd_frame_header_t hdr;
+    bool ok = convert_png_to_frame(file_path, epd_buffer, buf_size, &hdr, 0);
+    photo_files_unlock();
+    if (ok) {
+        epad_disp_frame(epd_buffer);
+    }
+    free(epd_buffer);
 }
 
 float read_battery_voltage(void)
@@ -1488,6 +2737,9 @@ float read_battery_voltage(void)
 
     r = adc_oneshot_read(adc2_handle, ADC_CHANNEL_2, &adc_raw);
 
+    // 다음 호출에서 다시 new_unit 할 수 있도록 바로 해제
+    ESP_ERROR_CHECK(adc_oneshot_del_unit(adc2_handle));
+
     if (r == ESP_OK)
     {
         // ADC의 최대 값
@@ -1519,8 +2771,7 @@ void web_server_task(void *pvParameters)
     TickType_t xLastWakeTime;
     xLastWakeTime = xTaskGetTickCount();
 
-    char *g_png_files[MAX_FILES];
-    int  g_png_count = 0;
+    char png_path[256];
 
     while(true) {
         // float battery_voltage = read_battery_voltage();
@@ -1538,20 +2789,14 @@ void web_server_task(void *pvParameters)
         //     esp_deep_sleep_start();
         // }
 
-        g_png_count = get_png_file_list(g_png_files, MAX_FILES);
-        ESP_LOGI(TAG, "Found %d PNG files", g_png_count);
-
+        // 마지막 표시 위치에서 (지난 시간 / 표시 간격)만큼 나아간다 (slideshow_pick)
         time_t now_sec = get_rtc_time_in_seconds();
-        if (g_png_count > 0) {
-            // index = ( now_sec / interval_seconds ) % g_file_count
-            uint64_t cycles = now_sec / interval_seconds_onusb; 
-            int index = cycles % g_png_count;
-
-            ESP_LOGI(TAG, "Current Time: %lld sec, cycles=%lld, index=%d",
-                    (long long)now_sec, (long long)cycles, index);
+        ESP_LOGI(TAG, "Current Time: %lld sec", (long long)now_sec);
 
+        uint32_t src_hash;
+        if (slideshow_pick(now_sec, interval_seconds_onusb, png_path, sizeof(png_path), &src_hash)) {
             // (2-1) 해당 파일 표시
-            display_png_file(g_png_files[index]);
+            display_png_file(png_path, src_hash);
 
             // e-Paper 자체를 절전 모드로 전환
             // epaper_sleep();
@@ -1708,42 +2953,65 @@ void wifi_cleanup(void)
     }
 }
 
-void check_battery_and_control_wifi(void)
-{
-    float battery_voltage = read_battery_voltage();
-    ESP_LOGI(TAG, "배터리 전압: %.2f V", battery_voltage);
+// 배터리 전압에 따른 동작 구분
+typedef enum {
+    BATTERY_ABSENT,     // 배터리 없음 (USB 전원): 슬립하지 않음
+    BATTERY_LOW,        // 배터리 구동: 표시 후 바로 딥슬립
+    BATTERY_OK,         // 충분: Wi-Fi / 웹 서버 활성화
+} battery_state_t;
 
-    if (battery_voltage < 2.0)
-    {
-        ESP_LOGI(TAG, "배터리가 없습니다. 슬립 모드로 진입하지 않습니다.");
+battery_state_t classify_battery(float battery_voltage)
+{
+    if (battery_voltage < 2.0) {
+        return BATTERY_ABSENT;
     }
-    else if (battery_voltage <= 4.0)
-    {
-        ESP_LOGI(TAG, "배터리 전압이 낮아 슬립 모드로 진입합니다.");
+    if (battery_voltage <= 4.0) {
+        return BATTERY_LOW;
+    }
+    return BATTERY_OK;
+}
 
-        char *g_png_files[MAX_FILES];
-        int  g_png_count = 0;
+// 딥슬립 깨어남 전용 경로
+// Wi-Fi, NVS, SPIFFS, mDNS는 건드리지 않고 SD 카드만 마운트해서
+// 다음 사진을 표시한 뒤 바로 딥슬립으로 돌아간다.
+// 부팅(esp_timer 시작)부터 슬립 진입 직전까지의 시간을 마지막에 남긴다.
+void fast_wake_display_and_sleep(esp_sleep_wakeup_cause_t wakeup_reason)
+{
+    ESP_LOGI(TAG, "배터리 구동: 빠른 표시 경로 (깨어난 원인: %d)", wakeup_reason);
 
-        g_png_count = get_png_file_list(g_png_files, MAX_FILES);
-        ESP_LOGI(TAG, "Found %d PNG files", g_png_count);
+    init_sd_card();
+    photo_index_init(MOUNT_POINT);
 
-        time_t now_sec = get_rtc_time_in_seconds();
-        if (g_png_count > 0) {
-            uint64_t cycles = now_sec / interval_seconds; 
-            int index = cycles % g_png_count;
+    int64_t mount_us = esp_timer_get_time();
 
-            ESP_LOGI(TAG, "Current Time: %lld sec, cycles=%lld, index=%d",
-                    (long long)now_sec, (long long)cycles, index);
+    // 필요한 파일 하나만 찾음 (디렉터리가 바뀐 경우에만 전체 스캔)
+    char png_path[256];
+    time_t now_sec = get_rtc_time_in_seconds();
+    ESP_LOGI(TAG, "Current Time: %lld sec", (long long)now_sec);
 
-            display_png_file(g_png_files[index]);
-        } 
+    uint32_t src_hash;
+    if (slideshow_pick(now_sec, interval_seconds, png_path, sizeof(png_path), &src_hash)) {
+        display_png_file(png_path, src_hash);
+    }
+
+    int64_t done_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "wake-to-sleep: %lld ms (boot+mount %lld ms, display %lld ms)",
+             (long long)(done_us / 1000), (long long)(mount_us / 1000),
+             (long long)((done_us - mount_us) / 1000));
+
+    // 슬립 타이머 설정
+    esp_sleep_enable_timer_wakeup(SLEEP_TIME_SEC * 1000000ULL); // 마이크로초 단위
+    ESP_LOGI(TAG, "%d초 동안 깊은 슬립에 들어갑니다.", SLEEP_TIME_SEC);
 
-        // 슬립 타이머 설정
-        esp_sleep_enable_timer_wakeup(SLEEP_TIME_SEC * 1000000ULL); // 마이크로초 단위
-        ESP_LOGI(TAG, "%d초 동안 깊은 슬립에 들어갑니다.", SLEEP_TIME_SEC);
+    // 깊은 슬립 시작
+    esp_deep_sleep_start();
+}
 
-        // 깊은 슬립 시작
-        esp_deep_sleep_start();
+void check_battery_and_control_wifi(battery_state_t battery)
+{
+    if (battery == BATTERY_ABSENT)
+    {
+        ESP_LOGI(TAG, "배터리가 없습니다. 슬립 모드로 진입하지 않습니다.");
     }
     else
     {
@@ -1763,6 +3031,26 @@ void check_battery_and_control_wifi(void)
 
 void app_main(void)
 {
+    // 깨어난 원인과 배터리 상태를 가장 먼저 판단
+    // (ADC2는 Wi-Fi 시작 전에 읽어야 한다)
+    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+    float battery_voltage = read_battery_voltage();
+    ESP_LOGI(TAG, "배터리 전압: %.2f V", battery_voltage);
+    battery_state_t battery = classify_battery(battery_voltage);
+
+    // 시간대 설정 (한국 시간)
+    setenv("TZ", "KST-9", 1);
+    tzset();
+
+    gpio_init();
+    spi_init();
+    epd_pm_init();
+
+    if (battery == BATTERY_LOW) {
+        // 돌아오지 않음 (딥슬립)
+        fast_wake_display_and_sleep(wakeup_reason);
+    }
+
     // NVS 초기화 (Wi-Fi 사용을 위해 필요)
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
@@ -1772,20 +3060,17 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
-    // 시간대 설정 (한국 시간)
-    setenv("TZ", "KST-9", 1);
-    tzset();
-
-    gpio_init();
-    spi_init();
+    // 팔레트 LUT 생성 (PNG 변환 전에 한 번)
+    epd_color_lut_init();
 
     init_spiffs();
 
     // setSDCardMODE(false);
     init_sd_card();
+    photo_index_init(MOUNT_POINT);
 
-    // 배터리 전압 확인 및 Wi-Fi 활성화 결정
-    check_battery_and_control_wifi();
+    // Wi-Fi 활성화 결정
+    check_battery_and_control_wifi(battery);
 
     // 현재 시간 출력
     time_t now;
@@ -1795,7 +3080,6 @@ void app_main(void)
     ESP_LOGI(TAG, "현재 시간: %s", asctime(&timeinfo));
 
     // 깨어난 원인 출력
-    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     switch(wakeup_reason)
     {
         case ESP_SLEEP_WAKEUP_TIMER:
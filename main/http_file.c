@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "http_file.h"
+
+static const char *TAG = "http_file";
+
+static uint8_t *s_buf = NULL;
+static size_t s_buf_len = 0;
+static const char *s_buf_where = "none";
+
+// 최근 전송 기록 (/api/bench)
+#define BENCH_RECORDS  8
+
+typedef struct {
+    char path[48];          // 경로 끝부분
+    uint32_t bytes;
+    uint32_t us;
+    bool chunked;
+} bench_rec_t;
+
+static bench_rec_t s_bench[BENCH_RECORDS];
+static int s_bench_count = 0;
+static int s_bench_next = 0;
+
+esp_err_t http_file_init(void)
+{
+    if (s_buf) {
+        return ESP_OK;
+    }
+
+    // SD(SPI)는 DMA 가능한 버퍼면 섹터를 바로 읽어 넣고, 아니면 섹터마다 바운스 복사한다
+    size_t len = CONFIG_HTTP_FILE_BUF_SIZE;
+    s_buf = heap_caps_malloc(len, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    s_buf_where = "dma";
+    if (!s_buf) {
+        s_buf = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        s_buf_where = "psram";
+    }
+    while (!s_buf && len > 1024) {
+        len /= 2;
+        s_buf = heap_caps_malloc(len, MALLOC_CAP_8BIT);
+        s_buf_where = "heap";
+    }
+    if (!s_buf) {
+        s_buf_where = "none";
+        ESP_LOGE(TAG, "전송 버퍼 할당 실패");
+        return ESP_ERR_NO_MEM;
+    }
+    s_buf_len = len;
+    ESP_LOGI(TAG, "전송 버퍼 %u 바이트 (%s)", (unsigned)s_buf_len, s_buf_where);
+    return ESP_OK;
+}
+
+uint8_t *http_file_buffer(size_t *len)
+{
+    *len = s_buf_len;
+    return s_buf;
+}
+
+void http_file_resp_init(http_file_resp_t *resp, httpd_req_t *req)
+{
+    memset(resp, 0, sizeof(*resp));
+    resp->req = req;
+}
+
+void http_file_set_type(http_file_resp_t *resp, const char *type)
+{
+    resp->type = type;
+    httpd_resp_set_type(resp->req, type);
+}
+
+void http_file_set_hdr(http_file_resp_t *resp, const char *field, const char *value)
+{
+    if (resp->hdr_count >= HTTP_FILE_MAX_HDRS) {
+        ESP_LOGW(TAG, "헤더가 너무 많음: %s", field);
+        return;
+    }
+    resp->hdr_field[resp->hdr_count] = field;
+    resp->hdr_value[resp->hdr_count] = value;
+    resp->hdr_count++;
+    httpd_resp_set_hdr(resp->req, field, value);
+}
+
+static esp_err_t send_all(httpd_req_t *req, const char *buf, size_t len)
+{
+    while (len > 0) {
+        int sent = httpd_send(req, buf, len);
+        if (sent < 0) {
+            return ESP_FAIL;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+static bool want_chunked(httpd_req_t *req)
+{
+    char query[48];
+    char value[16];
+    return httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, "send", value, sizeof(value)) == ESP_OK
+        && strcmp(value, "chunked") == 0;
+}
+
+// 예전 방식: 512바이트 스택 버퍼 + 청크 인코딩 (/api/bench 비교용)
+static esp_err_t send_chunked(http_file_resp_t *resp, FILE *file, size_t *sent_bytes)
+{
+    char buffer[512];
+    size_t read_bytes;
+    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        if (httpd_resp_send_chunk(resp->req, buffer, read_bytes) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        *sent_bytes += read_bytes;
+    }
+    return httpd_resp_send_chunk(resp->req, NULL, 0);
+}
+
+// "bytes=a-b", "bytes=a-", "bytes=-n" 하나만 처리한다.
+// 1: 구간 사용, 0: 무시하고 전체 전송, -1: 범위 밖 (416)
+static int parse_range(const char *value, size_t size, size_t *first, size_t *last)
+{
+    if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',') != NULL) {
+        return 0;   // 다른 단위나 여러 구간은 전체를 보내도 된다 (RFC 7233)
+    }
+    const char *p = value + 6;
+    char *end;
+    if (*p == '-') {
+        unsigned long n = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || *end != '\0') {
+            return 0;
+        }
+        if (n == 0 || size == 0) {
+            return -1;
+        }
+        *first = n >= size ? 0 : size - n;
+        *last = size - 1;
+        return 1;
+    }
+
+    unsigned long a = strtoul(p, &end, 10);
+    if (end == p || *end != '-') {
+        return 0;
+    }
+    p = end + 1;
+    unsigned long b = size ? size - 1 : 0;
+    if (*p != '\0') {
+        b = strtoul(p, &end, 10);
+        if (end == p || *end != '\0' || b < a) {
+            return 0;
+        }
+    }
+    if (a >= size) {
+        return -1;
+    }
+    *first = a;
+    *last = MIN(b, size - 1);
+    return 1;
+}
+
+static esp_err_t send_length(http_file_resp_t *resp, FILE *file, size_t size, size_t *sent_bytes)
+{
+    size_t total = size;
+    size_t first = 0;
+    bool partial = false;
+
+    if (resp->ranges) {
+        http_file_set_hdr(resp, "Accept-Ranges", "bytes");
+
+        char range[64];
+        char if_range[sizeof(resp->etag)];
+        size_t last;
+        int r = 0;
+        if (httpd_req_get_hdr_value_str(resp->req, "Range", range, sizeof(range)) == ESP_OK) {
+            r = parse_range(range, total, &first, &last);
+        }
+        // 그사이 파일이 바뀌었으면 (If-Range 불일치) 구간 대신 전체.
+        // 값이 버퍼보다 길어 잘렸거나 (ETag보다 긴 값, HTTP-date 등) 읽지 못한 경우도
+        // 일치를 확인할 수 없으므로 전체로 보낸다. 헤더가 없을 때만 구간을 그대로 쓴다.
+        if (r != 0) {
+            esp_err_t err = httpd_req_get_hdr_value_str(resp->req, "If-Range", if_range, sizeof(if_range));
+            if (err != ESP_ERR_NOT_FOUND && (err != ESP_OK || strcmp(if_range, resp->etag) != 0)) {
+                r = 0;
+            }
+        }
+        if (r < 0) {
+            snprintf(resp->content_range, sizeof(resp->content_range), "bytes */%u", (unsigned)total);
+            httpd_resp_set_status(resp->req, "416 Range Not Satisfiable");
+            httpd_resp_set_hdr(resp->req, "Content-Range", resp->content_range);
+            httpd_resp_send(resp->req, NULL, 0);
+            return ESP_OK;
+        }
+        if (r > 0) {
+            if (fseek(file, (long)first, SEEK_SET) != 0) {
+                httpd_resp_send_err(resp->req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+                return ESP_FAIL;
+            }
+            snprintf(resp->content_range, sizeof(resp->content_range), "bytes %u-%u/%u",
+                     (unsigned)first, (unsigned)last, (unsigned)total);
+            http_file_set_hdr(resp, "Content-Range", resp->content_range);
+            size = last - first + 1;
+            partial = true;
+        }
+    }
+
+    char hdr[512];
+    int len = snprintf(hdr, sizeof(hdr),
+                       "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n",
+                       partial ? "206 Partial Content" : "200 OK",
+                       resp->type ? resp->type : "application/octet-stream", (unsigned)size);
+    for (int i = 0; i < resp->hdr_count && len < (int)sizeof(hdr); i++) {
+        len += snprintf(hdr + len, sizeof(hdr) - len, "%s: %s\r\n",
+                        resp->hdr_field[i], resp->hdr_value[i]);
+    }
+    if (len < (int)sizeof(hdr)) {
+        len += snprintf(hdr + len, sizeof(hdr) - len, "\r\n");
+    }
+    if (len >= (int)sizeof(hdr)) {
+        ESP_LOGE(TAG, "응답 헤더가 너무 김");
+        httpd_resp_send_err(resp->req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_FAIL;
+    }
+    if (send_all(resp->req, hdr, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // Content-Length를 이미 보냈으므로 중간에 끊기면 ESP_FAIL로 연결을 닫게 한다
+    size_t remaining = size;
+    while (remaining > 0) {
+        size_t got = fread(s_buf, 1, MIN(remaining, s_buf_len), file);
+        if (got == 0) {
+            ESP_LOGE(TAG, "파일 읽기 실패 (%u 바이트 남음)", (unsigned)remaining);
+            return ESP_FAIL;
+        }
+        if (send_all(resp->req, (const char *)s_buf, got) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        remaining -= got;
+        *sent_bytes += got;
+    }
+    return ESP_OK;
+}
+
+static void bench_record(const char *path, size_t bytes, int64_t us, bool chunked)
+{
+    bench_rec_t *r = &s_bench[s_bench_next];
+    size_t len = strlen(path);
+    size_t keep = MIN(len, sizeof(r->path) - 1);
+    memcpy(r->path, path + len - keep, keep);
+    r->path[keep] = '\0';
+    for (char *c = r->path; *c; c++) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+            *c = '_';
+        }
+    }
+    r->bytes = bytes;
+    r->us = us > 0 ? (uint32_t)us : 1;
+    r->chunked = chunked;
+    s_bench_next = (s_bench_next + 1) % BENCH_RECORDS;
+    if (s_bench_count < BENCH_RECORDS) {
+        s_bench_count++;
+    }
+}
+
+esp_err_t http_file_send(http_file_resp_t *resp, const char *path)
+{
+    struct stat st;
+    FILE *file = NULL;
+    if (stat(path, &st) == 0) {
+        file = fopen(path, "rb");
+    }
+    if (!file) {
+        ESP_LOGE(TAG, "파일 열기 실패: %s", path);
+        httpd_resp_send_err(resp->req, HTTPD_404_NOT_FOUND, "파일을 찾을 수 없습니다.");
+        return ESP_FAIL;
+    }
+
+    // 읽기는 항상 전송 버퍼 크기로 하므로 stdio 버퍼는 거치지 않게 한다
+    setvbuf(file, NULL, _IONBF, 0);
+
+    if (resp->ranges) {
+        snprintf(resp->etag, sizeof(resp->etag), "\"%lx-%llx\"",
+                 (unsigned long)st.st_size, (unsigned long long)st.st_mtime);
+        http_file_set_hdr(resp, "ETag", resp->etag);
+    }
+
+    bool chunked = !s_buf || want_chunked(resp->req);
+    size_t sent = 0;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = chunked ? send_chunked(resp, file, &sent)
+                            : send_length(resp, file, st.st_size, &sent);
+    int64_t us = esp_timer_get_time() - start_us;
+    fclose(file);
+
+    bench_record(path, sent, us, chunked);
+    ESP_LOGI(TAG, "%s: %u 바이트, %lld ms, %.2f MB/s (%s)", path, (unsigned)sent,
+             (long long)(us / 1000), us > 0 ? (double)sent / us : 0.0,
+             chunked ? "chunked" : "length");
+    return ret;
+}
+
+// GET /api/bench
+// 예: curl -o /dev/null /image/a.png?send=chunked; curl -o /dev/null /image/a.png; curl /api/bench
+esp_err_t http_file_bench_get_handler(httpd_req_t *req)
+{
+    char buf[160 + BENCH_RECORDS * 160];
+    int len = snprintf(buf, sizeof(buf), "{\"buffer\":%u,\"buffer_mem\":\"%s\",\"transfers\":[",
+                       (unsigned)s_buf_len, s_buf_where);
+
+    // 최근 것부터
+    for (int i = 0; i < s_bench_count; i++) {
+        const bench_rec_t *r = &s_bench[(s_bench_next - 1 - i + BENCH_RECORDS) % BENCH_RECORDS];
+        len += snprintf(buf + len, sizeof(buf) - len,
+                        "%s{\"path\":\"%s\",\"bytes\":%lu,\"ms\":%lu,\"mbps\":%.2f,\"mode\":\"%s\"}",
+                        i ? "," : "", r->path, (unsigned long)r->bytes,
+                        (unsigned long)(r->us / 1000), (double)r->bytes / r->us,
+                        r->chunked ? "chunked" : "length");
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, buf, len);
+}
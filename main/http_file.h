@@ -0,0 +1,58 @@
+/*
+ * http_file.h
+ *
+ * 파일 응답 전송 (SD 카드 사진, SPIFFS 웹 자산, 미리보기)
+ *
+ * httpd_resp_send_chunk()는 항상 청크 인코딩을 쓰고, 512바이트 스택 버퍼로 보내면
+ * 1 MB 사진 하나에 send가 2천 번 가까이 일어난다. 여기서는 stat으로 크기를 먼저 알고
+ * Content-Length 헤더를 직접 써서 청크 없이 본문을 보낸다. 본문 버퍼는 서버 태스크가
+ * 같이 쓰는 큰 버퍼 하나다 (esp_http_server는 핸들러를 서버 태스크 하나에서 차례로 부른다).
+ *
+ * httpd는 httpd_resp_set_hdr()로 넣은 헤더를 돌려주지 않으므로 응답 헤더는
+ * http_file_resp_t에 모아 두었다가 직접 쓴다. 304/오류 응답도 같은 헤더를 쓰도록
+ * httpd 쪽에도 함께 넣는다.
+ *
+ * ranges를 켜면 "Range: bytes=" 요청에 206 Partial Content로 해당 구간만 보낸다
+ * (파일에서 바로 fseek). ETag(크기+수정 시각)를 같이 보내고 If-Range가 다르면 전체를 보낸다.
+ *
+ * 요청에 "?send=chunked"를 붙이면 예전 방식(512바이트 청크)으로 보낸다.
+ * 전송마다 걸린 시간을 기록해 두고 GET /api/bench에서 MB/s로 보여준다.
+ */
+#ifndef __HTTP_FILE_H
+#define __HTTP_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_http_server.h>
+
+#define HTTP_FILE_MAX_HDRS  6
+
+typedef struct {
+    httpd_req_t *req;
+    const char *type;                           // Content-Type
+    int hdr_count;
+    const char *hdr_field[HTTP_FILE_MAX_HDRS];  // 값은 응답을 보낼 때까지 유효해야 한다
+    const char *hdr_value[HTTP_FILE_MAX_HDRS];
+    bool ranges;                                // Range 요청 허용
+    char etag[32];
+    char content_range[48];
+} http_file_resp_t;
+
+// 전송 버퍼 할당 (서버 시작 시 한 번). DMA 가능한 내부 RAM -> PSRAM 순으로 시도
+esp_err_t http_file_init(void);
+
+void http_file_resp_init(http_file_resp_t *resp, httpd_req_t *req);
+void http_file_set_type(http_file_resp_t *resp, const char *type);
+void http_file_set_hdr(http_file_resp_t *resp, const char *field, const char *value);
+
+// 전송 버퍼를 빌려 쓴다 (같은 서버 태스크의 업로드 핸들러용). 없으면 NULL
+uint8_t *http_file_buffer(size_t *len);
+
+// 파일 전체 (또는 Range 구간)를 보낸다. 파일이 없으면 404를 보내고 ESP_FAIL
+esp_err_t http_file_send(http_file_resp_t *resp, const char *path);
+
+// GET /api/bench: 최근 전송 기록 (JSON)
+esp_err_t http_file_bench_get_handler(httpd_req_t *req);
+
+#endif
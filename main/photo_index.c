@@ -0,0 +1,519 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_vfs_fat.h"
+#include "photo_index.h"
+
+static const char *TAG = "photo_index";
+
+static char s_dir[64];
+static char s_path[96];
+static photo_index_header_t s_hdr;
+static bool s_ready = false;
+static SemaphoreHandle_t s_lock = NULL;
+
+static const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static long record_pos(int n)
+{
+    return (long)sizeof(photo_index_header_t) + (long)n * (long)sizeof(photo_index_record_t);
+}
+
+static uint64_t card_free_bytes(void)
+{
+    uint64_t total = 0, free_bytes = 0;
+    if (esp_vfs_fat_info(s_dir, &total, &free_bytes) != ESP_OK) {
+        return 0;
+    }
+    return free_bytes;
+}
+
+static bool header_valid(const photo_index_header_t *hdr)
+{
+    return memcmp(hdr->magic, PHOTO_INDEX_MAGIC, sizeof(hdr->magic)) == 0
+        && hdr->version == PHOTO_INDEX_VERSION
+        && hdr->header_size == sizeof(photo_index_header_t)
+        && hdr->record_size == sizeof(photo_index_record_t);
+}
+
+// 레코드를 다 쓴 뒤 호출: 여유 공간 스탬프를 찍고 헤더를 덮어쓴다
+// (헤더는 크기가 변하지 않으므로 스탬프가 어긋나지 않는다)
+static bool write_header(FILE *fp)
+{
+    fflush(fp);
+    s_hdr.free_bytes = card_free_bytes();
+    return fseek(fp, 0, SEEK_SET) == 0
+        && fwrite(&s_hdr, 1, sizeof(s_hdr), fp) == sizeof(s_hdr);
+}
+
+static const char *base_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static bool is_png_name(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+    return ext && strcasecmp(ext, ".png") == 0;
+}
+
+// IHDR에서 가로/세로만 읽는다 (시그니처 8 + 길이 4 + "IHDR" 4 + 가로 4 + 세로 4)
+static bool read_png_dims(const char *path, uint16_t *width, uint16_t *height)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    uint8_t head[24];
+    bool ok = fread(head, 1, sizeof(head), fp) == sizeof(head)
+           && memcmp(head, png_signature, sizeof(png_signature)) == 0
+           && memcmp(head + 12, "IHDR", 4) == 0;
+    fclose(fp);
+    if (!ok) {
+        return false;
+    }
+    uint32_t w = ((uint32_t)head[16] << 24) | ((uint32_t)head[17] << 16) | ((uint32_t)head[18] << 8) | head[19];
+    uint32_t h = ((uint32_t)head[20] << 24) | ((uint32_t)head[21] << 16) | ((uint32_t)head[22] << 8) | head[23];
+    *width = w > UINT16_MAX ? UINT16_MAX : (uint16_t)w;
+    *height = h > UINT16_MAX ? UINT16_MAX : (uint16_t)h;
+    return true;
+}
+
+// 이미 변환된 .epd가 원본과 맞으면 그 정보를 레코드에 옮긴다
+static void fill_frame_info(photo_index_record_t *rec, const epd_frame_header_t *frame)
+{
+    rec->rotate = frame->rotate;
+    rec->dither = frame->dither;
+    rec->flags |= PHOTO_INDEX_FRAME_VALID;
+    rec->frame_offset = frame->header_size;
+    rec->hash = frame->src_hash;
+}
+
+static bool fill_record(photo_index_record_t *rec, const char *png_path, const epd_frame_header_t *frame)
+{
+    memset(rec, 0, sizeof(*rec));
+
+    const char *name = base_name(png_path);
+    if (strlen(name) >= sizeof(rec->name)) {
+        ESP_LOGW(TAG, "Name too long for index: %s", name);
+        return false;
+    }
+    strcpy(rec->name, name);
+
+    struct stat st;
+    if (stat(png_path, &st) != 0) {
+        return false;
+    }
+    rec->size = (uint32_t)st.st_size;
+    rec->mtime = (uint32_t)st.st_mtime;
+
+    uint16_t width, height;     // 패킹된 멤버 주소는 넘기지 않는다
+    if (read_png_dims(png_path, &width, &height)) {
+        rec->width = width;
+        rec->height = height;
+        rec->rotate = width > height ? 90 : 0;
+    }
+
+    if (frame) {
+        fill_frame_info(rec, frame);
+        return true;
+    }
+
+    // 재구성 중: 캐시된 .epd 헤더가 원본과 맞는지 확인
+    char frame_path[256];
+    if (!epd_frame_path(frame_path, sizeof(frame_path), png_path)) {
+        return true;
+    }
+    FILE *fp = fopen(frame_path, "rb");
+    if (fp) {
+        epd_frame_header_t hdr;
+        if (fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr)
+            && memcmp(hdr.magic, EPD_FRAME_MAGIC, sizeof(hdr.magic)) == 0
+            && hdr.version == EPD_FRAME_VERSION
+            && hdr.src_size == rec->size && hdr.src_mtime == rec->mtime) {
+            fill_frame_info(rec, &hdr);
+        }
+        fclose(fp);
+    }
+    return true;
+}
+
+// name과 같은 레코드 위치 (없으면 -1). 여러 레코드를 한 번에 읽는다.
+// 빠른 깨어남 경로에서는 메인 태스크(스택 3.5 KB)에서 불리므로 묶음은 4개 (1,152바이트)
+static int find_record(FILE *fp, const char *name)
+{
+    photo_index_record_t batch[4];
+    int n = 0;
+    if (fseek(fp, record_pos(0), SEEK_SET) != 0) {
+        return -1;
+    }
+    while (n < (int)s_hdr.count) {
+        int want = s_hdr.count - n;
+        if (want > (int)(sizeof(batch) / sizeof(batch[0]))) {
+            want = sizeof(batch) / sizeof(batch[0]);
+        }
+        int got = fread(batch, sizeof(batch[0]), want, fp);
+        for (int i = 0; i < got; i++) {
+            if (strncmp(batch[i].name, name, sizeof(batch[i].name)) == 0) {
+                return n + i;
+            }
+        }
+        if (got < want) {
+            break;
+        }
+        n += got;
+    }
+    return -1;
+}
+
+// 전원이 끊겨 남은 업로드 파일 정리. <name>.part와 <name>.tmp (.epd/미리보기/인덱스를
+// 쓰던 임시 파일)는 지우고, <name>.old는 <name>이 있으면
+// 지우고 없으면 (교체 도중 끊김) 되돌린다. rename은 디렉터리를 바꾸므로 하고 나면 처음부터
+// 다시 훑는다. 다른 태스크가 파일을 쓰기 전인 부팅 때 (photo_index_init)만 부른다.
+// 실행 중 재구성(photo_index_rebuild)에서는 받고 있는 업로드의 .part를 지울 수 있어서 부르지 않는다.
+static void sweep_upload_leftovers(void)
+{
+    const size_t path_len = sizeof(s_dir) + 256 + 2;
+    char *path = (char *)malloc(path_len);     // 빠른 깨어남 경로의 메인 태스크 스택을 아낀다
+    if (!path) {
+        return;
+    }
+    bool again = true;
+    while (again) {
+        again = false;
+        DIR *dir = opendir(s_dir);
+        if (!dir) {
+            break;
+        }
+        struct dirent *entry;
+        while (!again && (entry = readdir(dir)) != NULL) {
+            const char *ext = strrchr(entry->d_name, '.');
+            if (entry->d_type != DT_REG || !ext) {
+                continue;
+            }
+            snprintf(path, path_len, "%s/%s", s_dir, entry->d_name);
+            if (strcasecmp(ext, PHOTO_UPLOAD_TMP_EXT) == 0 || strcasecmp(ext, ".tmp") == 0) {
+                ESP_LOGW(TAG, "Removing partial file: %s", path);
+                unlink(path);
+            } else if (strcasecmp(ext, PHOTO_UPLOAD_OLD_EXT) == 0) {
+                char *orig = strndup(path, strlen(path) - strlen(ext));
+                struct stat st;
+                if (!orig) {
+                    continue;
+                }
+                if (stat(orig, &st) == 0) {
+                    unlink(path);
+                } else {
+                    ESP_LOGW(TAG, "Restoring interrupted replace: %s", orig);
+                    again = rename(path, orig) == 0;
+                }
+                free(orig);
+            }
+        }
+        closedir(dir);
+    }
+    free(path);
+}
+
+static bool rebuild_locked(void)
+{
+    char tmp_path[sizeof(s_path) + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", s_path);
+    char png_path[sizeof(s_dir) + 256 + 2];
+
+    DIR *dir = opendir(s_dir);
+    if (!dir) {
+        ESP_LOGE(TAG, "Failed to open directory: %s", s_dir);
+        return false;
+    }
+    FILE *fp = fopen(tmp_path, "w+b");
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to create index: %s", tmp_path);
+        closedir(dir);
+        return false;
+    }
+
+    uint32_t generation = header_valid(&s_hdr) ? s_hdr.generation + 1 : 1;
+    memset(&s_hdr, 0, sizeof(s_hdr));
+    memcpy(s_hdr.magic, PHOTO_INDEX_MAGIC, sizeof(s_hdr.magic));
+    s_hdr.version = PHOTO_INDEX_VERSION;
+    s_hdr.header_size = sizeof(photo_index_header_t);
+    s_hdr.record_size = sizeof(photo_index_record_t);
+    s_hdr.generation = generation;
+
+    bool ok = fwrite(&s_hdr, 1, sizeof(s_hdr), fp) == sizeof(s_hdr);
+
+    struct dirent *entry;
+    photo_index_record_t rec;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_REG || !is_png_name(entry->d_name)) {
+            continue;
+        }
+        snprintf(png_path, sizeof(png_path), "%s/%s", s_dir, entry->d_name);
+        if (!fill_record(&rec, png_path, NULL)) {
+            continue;
+        }
+        ok = fwrite(&rec, 1, sizeof(rec), fp) == sizeof(rec);
+        s_hdr.count++;
+    }
+    closedir(dir);
+
+    // 이전 인덱스를 먼저 지워야 스탬프가 최종 여유 공간과 맞는다
+    unlink(s_path);
+    ok = ok && write_header(fp);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp_path, s_path) != 0) {
+        ESP_LOGE(TAG, "Failed to write index: %s", s_path);
+        unlink(tmp_path);
+        s_ready = false;
+        return false;
+    }
+
+    s_ready = true;
+    ESP_LOGI(TAG, "Index rebuilt: %lu photos (generation %lu)",
+             (unsigned long)s_hdr.count, (unsigned long)s_hdr.generation);
+    return true;
+}
+
+bool photo_index_init(const char *dir)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) {
+            return false;
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    snprintf(s_dir, sizeof(s_dir), "%s", dir);
+    snprintf(s_path, sizeof(s_path), "%s/%s", dir, PHOTO_INDEX_FILE);
+
+    bool ok = false;
+    FILE *fp = fopen(s_path, "rb");
+    if (fp) {
+        ok = fread(&s_hdr, 1, sizeof(s_hdr), fp) == sizeof(s_hdr) && header_valid(&s_hdr);
+        fclose(fp);
+    }
+
+    if (ok && s_hdr.free_bytes == card_free_bytes()) {
+        s_ready = true;
+        ESP_LOGI(TAG, "Index loaded: %lu photos (generation %lu)",
+                 (unsigned long)s_hdr.count, (unsigned long)s_hdr.generation);
+    } else {
+        // 전원이 끊긴 업로드는 .part가 여유 공간을 바꾸므로 여기서 정리된다
+        ESP_LOGI(TAG, "Index %s, rebuilding", ok ? "out of date" : "missing");
+        sweep_upload_leftovers();
+        ok = rebuild_locked();
+    }
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+bool photo_index_rebuild(void)
+{
+    if (!s_lock) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = rebuild_locked();
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+// s_hdr는 httpd 태스크(업로드/삭제)가 바꾸므로 읽을 때도 잠근다
+int photo_index_count(void)
+{
+    if (!s_lock) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int count = s_ready ? (int)s_hdr.count : 0;
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+uint32_t photo_index_generation(void)
+{
+    if (!s_lock) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t generation = s_hdr.generation;
+    xSemaphoreGive(s_lock);
+    return generation;
+}
+
+bool photo_index_get(int n, photo_index_record_t *rec)
+{
+    if (!s_ready || n < 0) {
+        return false;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = false;
+    if (n < (int)s_hdr.count) {
+        FILE *fp = fopen(s_path, "rb");
+        if (fp) {
+            ok = fseek(fp, record_pos(n), SEEK_SET) == 0
+              && fread(rec, 1, sizeof(*rec), fp) == sizeof(*rec);
+            fclose(fp);
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+int photo_index_read(int start, photo_index_record_t *recs, int max)
+{
+    if (!s_ready || start < 0 || max <= 0) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int got = 0;
+    if (start < (int)s_hdr.count) {
+        if (max > (int)s_hdr.count - start) {
+            max = s_hdr.count - start;
+        }
+        FILE *fp = fopen(s_path, "rb");
+        if (fp) {
+            if (fseek(fp, record_pos(start), SEEK_SET) == 0) {
+                got = fread(recs, sizeof(*recs), max, fp);
+            }
+            fclose(fp);
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return got;
+}
+
+int photo_index_find(const char *name)
+{
+    if (!s_ready) {
+        return -1;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = -1;
+    FILE *fp = fopen(s_path, "rb");
+    if (fp) {
+        slot = find_record(fp, name);
+        fclose(fp);
+    }
+    xSemaphoreGive(s_lock);
+    return slot;
+}
+
+bool photo_index_path(const photo_index_record_t *rec, char *out, size_t out_len)
+{
+    int n = snprintf(out, out_len, "%s/%.*s", s_dir, (int)sizeof(rec->name), rec->name);
+    return n > 0 && n < (int)out_len;
+}
+
+bool photo_index_update_file(const char *png_path, const epd_frame_header_t *frame, uint32_t hash)
+{
+    if (!s_ready) {
+        return false;
+    }
+
+    photo_index_record_t rec;
+    if (!fill_record(&rec, png_path, frame)) {
+        return false;
+    }
+    if (hash) {
+        rec.hash = hash;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = false;
+    FILE *fp = fopen(s_path, "r+b");
+    if (fp) {
+        int slot = find_record(fp, rec.name);
+        if (slot < 0) {
+            slot = s_hdr.count;
+        }
+        ok = fseek(fp, record_pos(slot), SEEK_SET) == 0
+          && fwrite(&rec, 1, sizeof(rec), fp) == sizeof(rec);
+        if (ok) {
+            if (slot == (int)s_hdr.count) {
+                s_hdr.count++;
+            }
+            s_hdr.generation++;
+            ok = write_header(fp);
+        }
+        if (fclose(fp) != 0) {
+            ok = false;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to update index for %s", png_path);
+    }
+    return ok;
+}
+
+bool photo_index_remove(const char *png_path)
+{
+    if (!s_ready) {
+        return false;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = false;
+    FILE *fp = fopen(s_path, "r+b");
+    if (fp) {
+        int slot = find_record(fp, base_name(png_path));
+        if (slot < 0) {
+            ok = write_header(fp);      // 레코드는 없지만 스탬프는 갱신
+        } else {
+            // 마지막 레코드를 빈자리로 옮기고 개수만 줄인다
+            int last = s_hdr.count - 1;
+            photo_index_record_t rec;
+            ok = true;
+            if (slot != last) {
+                ok = fseek(fp, record_pos(last), SEEK_SET) == 0
+                  && fread(&rec, 1, sizeof(rec), fp) == sizeof(rec)
+                  && fseek(fp, record_pos(slot), SEEK_SET) == 0
+                  && fwrite(&rec, 1, sizeof(rec), fp) == sizeof(rec);
+            }
+            if (ok) {
+                s_hdr.count--;
+                s_hdr.generation++;
+                ok = write_header(fp);
+            }
+        }
+        if (fclose(fp) != 0) {
+            ok = false;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to remove %s from index", png_path);
+    }
+    return ok;
+}
+
+void photo_index_touch(void)
+{
+    if (!s_ready) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    FILE *fp = fopen(s_path, "r+b");
+    if (fp) {
+        write_header(fp);
+        fclose(fp);
+    }
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,93 @@
+/*
+ * photo_index.h
+ *
+ * SD 카드에 유지하는 사진 목록 인덱스 (photos.idx)
+ *
+ *   [photo_index_header_t 32바이트][photo_index_record_t 288바이트 * count]
+ *
+ * 레코드가 고정 크기라서 n번째 사진은 fseek 한 번으로 읽는다.
+ * 업로드/변환/삭제 때마다 레코드를 갱신하고, 헤더에는 마지막으로 기록했을 때의
+ * 카드 여유 공간을 남긴다. 부팅 시 여유 공간이 다르면 (카드 리더기로 직접
+ * 복사한 경우 등) 디렉터리를 한 번 훑어서 인덱스를 다시 만든다.
+ *
+ * 이름 칸은 readdir()이 돌려줄 수 있는 가장 긴 이름(FATFS LFN 255바이트 + NUL)을 담으므로
+ * 카드에 있는 PNG는 이름 길이 때문에 목록에서 빠지지 않는다.
+ */
+#ifndef __PHOTO_INDEX_H
+#define __PHOTO_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "epd_frame.h"
+
+#define PHOTO_INDEX_MAGIC     "PIDX"
+#define PHOTO_INDEX_VERSION   2
+#define PHOTO_INDEX_FILE      "photos.idx"
+#define PHOTO_INDEX_NAME_LEN  256     // CONFIG_FATFS_MAX_LFN(255) + NUL
+
+// 업로드가 받는 동안 쓰는 임시 파일 (<name>.part)과, 같은 이름을 교체하는 동안 예전 파일을
+// 잠시 옮겨 두는 이름 (<name>.old). 전원이 끊겨 남은 것은 재구성 때 정리한다.
+#define PHOTO_UPLOAD_TMP_EXT  ".part"
+#define PHOTO_UPLOAD_OLD_EXT  ".old"
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];      // "PIDX"
+    uint8_t  version;
+    uint8_t  header_size;   // sizeof(photo_index_header_t)
+    uint16_t record_size;   // sizeof(photo_index_record_t)
+    uint32_t count;         // 유효 레코드 수
+    uint32_t generation;    // 변경될 때마다 증가
+    uint64_t free_bytes;    // 마지막 기록 시점의 카드 여유 공간
+    uint32_t reserved[2];
+} photo_index_header_t;
+
+#define PHOTO_INDEX_FRAME_VALID  0x01   // .epd 캐시가 변환되어 있음
+
+typedef struct __attribute__((packed)) {
+    char     name[PHOTO_INDEX_NAME_LEN]; // 디렉터리 안의 파일 이름 (NUL 종료)
+    uint32_t size;          // PNG 크기
+    uint32_t mtime;         // PNG 수정 시각
+    uint16_t width;         // PNG 가로 (IHDR)
+    uint16_t height;        // PNG 세로 (IHDR)
+    uint8_t  rotate;        // 패널 방향 (0 / 90)
+    uint8_t  dither;        // 변환에 쓴 epd_dither_mode_t
+    uint8_t  flags;         // PHOTO_INDEX_FRAME_VALID
+    uint8_t  reserved0;
+    uint32_t frame_offset;  // .epd 안의 프레임 데이터 시작 위치 (변환 전에는 0)
+    uint32_t hash;          // 원본 PNG FNV-1a 32 (업로드 중 또는 첫 변환 때 계산, .epd 헤더와 같음. 모르면 0)
+    uint32_t reserved[2];
+} photo_index_record_t;
+
+// 인덱스 열기. 없거나 깨졌거나 카드가 밖에서 바뀌었으면 dir을 훑어서 다시 만든다.
+bool photo_index_init(const char *dir);
+
+// 디렉터리를 훑어서 인덱스를 새로 만든다
+bool photo_index_rebuild(void);
+
+int photo_index_count(void);
+uint32_t photo_index_generation(void);
+
+// n번째 레코드 읽기 (fseek 한 번)
+bool photo_index_get(int n, photo_index_record_t *rec);
+
+// start부터 최대 max개 레코드를 한 번에 읽는다 (반환: 읽은 개수)
+int photo_index_read(int start, photo_index_record_t *recs, int max);
+
+// 이름으로 레코드 위치 찾기 (없으면 -1)
+int photo_index_find(const char *name);
+
+// 레코드 경로: dir + "/" + name
+bool photo_index_path(const photo_index_record_t *rec, char *out, size_t out_len);
+
+// PNG 파일을 추가하거나 갱신한다. frame이 있으면 변환 결과(회전/디더링/원본 해시/오프셋)도 기록.
+// hash는 원본 PNG의 FNV-1a 32 (0이면 frame의 src_hash를 쓴다)
+bool photo_index_update_file(const char *png_path, const epd_frame_header_t *frame, uint32_t hash);
+
+// 삭제된 PNG의 레코드 제거 (마지막 레코드를 빈자리로 옮김)
+bool photo_index_remove(const char *png_path);
+
+// PNG 이외의 파일(캐시 등)을 썼을 때 여유 공간 스탬프만 갱신
+void photo_index_touch(void);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * epd_color_lut_test.c
+ *
+ * 호스트용 테스트: 24비트 RGB 전체(16,777,216개)를 epd_color_lut()과 기준 구현
+ * get_nearest_epd_color()에 넣어 비교한다.
+ *
+ * LUT는 채널당 상위 5비트 칸(8x8x8 값)마다 칸의 대표값 하나로 만든 색을 쓰므로, 팔레트
+ * 색 사이의 경계면(두 색까지 거리가 같은 평면)이 지나가는 칸에서는 칸 안의 일부 값이
+ * 다른 색으로 간다. 그 밖의 칸은 항상 같다. 여기서는
+ *   - 불일치 개수/비율과 경계가 지나가는 칸 수
+ *   - 불일치 값에서 LUT 색이 최선 색보다 얼마나 먼지 (거리 차의 최대값)
+ *   - 투명 픽셀(알파 < EPD_ALPHA_THRESHOLD)은 항상 흰색인지
+ * 를 확인하고, 불일치 비율이나 거리 차가 한도를 넘으면 실패한다.
+ *
+ * 현재 팔레트(6색)와 5비트 칸에서 측정한 값:
+ *   불일치 171,136개 (1.02%), 경계 칸 752개 (전체 칸의 2.29%)
+ *   대부분 흰색과 빨강/파랑/초록 사이 경계 (파랑 58,688개), 나머지는 빨강-파랑, 파랑-초록
+ *   최악 거리 차 9.89 (0, 135, 128) - 파랑/초록 경계, 한도(2 x 칸 대각선) 24.25
+ * 칸 대표값을 칸 중심으로 바꿔도 1.02%로 같다 (경계면 자체가 칸을 가르는 양이라 5비트의 한계).
+ * 불일치는 색 쌍별로 나눠 출력하므로 어느 경계에서 갈리는지 볼 수 있다.
+ *
+ *   cc -O2 -Imain -Itools/host tools/epd_color_lut_test.c main/epd_color.c -lm -o epd_color_lut_test
+ *   ./epd_color_lut_test
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "epd_color.h"
+
+// 한도: 불일치 비율 (전체 대비). 측정값 1.02%보다 조금 위로 두어 LUT 생성이 나빠지면 걸린다
+#define MAX_MISMATCH_RATE  0.011
+// 칸 안의 값 p와 대표값 q의 거리는 칸 대각선 d 이하이고, LUT 색 L은 q에서 가장 가까우므로
+// |pL| <= |pq| + |qL| <= |pq| + |qN| <= 2|pq| + |pN| (N: p에서 가장 가까운 색). 차는 2d 이하.
+#define MAX_DIST_EXCESS    (2.0 * sqrt(3.0) * ((1 << EPD_LUT_SHIFT) - 1))
+
+static int dist2(uint8_t r, uint8_t g, uint8_t b, uint8_t idx)
+{
+    for (int i = 0; i < g_color_count; i++) {
+        if (g_color_table[i].idx4 == idx) {
+            int dr = r - g_color_table[i].r, dg = g - g_color_table[i].g, db = b - g_color_table[i].b;
+            return dr * dr + dg * dg + db * db;
+        }
+    }
+    return -1;
+}
+
+int main(void)
+{
+    epd_color_lut_init();
+
+    const int cell_side = 1 << EPD_LUT_SHIFT;
+    long mismatches = 0, bad_cells = 0;
+    double worst_excess = 0.0;
+    int worst_rgb[3] = { 0, 0, 0 };
+    static long pairs[16][16];     // [LUT 색][기준 색] 불일치 수
+
+    // 칸 단위로 돌면서 칸 안의 모든 값을 비교
+    for (int cr = 0; cr < 256; cr += cell_side) {
+        for (int cg = 0; cg < 256; cg += cell_side) {
+            for (int cb = 0; cb < 256; cb += cell_side) {
+                long cell_bad = 0;
+                for (int r = cr; r < cr + cell_side; r++) {
+                    for (int g = cg; g < cg + cell_side; g++) {
+                        for (int b = cb; b < cb + cell_side; b++) {
+                            uint8_t lut = epd_color_lut(r, g, b, 0xff);
+                            uint8_t ref = get_nearest_epd_color(r, g, b, 0xff);
+                            if (lut == ref) {
+                                continue;
+                            }
+                            cell_bad++;
+                            pairs[lut][ref]++;
+                            double excess = sqrt(dist2(r, g, b, lut)) - sqrt(dist2(r, g, b, ref));
+                            if (excess > worst_excess) {
+                                worst_excess = excess;
+                                worst_rgb[0] = r;
+                                worst_rgb[1] = g;
+                                worst_rgb[2] = b;
+                            }
+                        }
+                    }
+                }
+                mismatches += cell_bad;
+                bad_cells += cell_bad != 0;
+            }
+        }
+    }
+
+    // 알파: 투명은 색과 관계없이 흰색, 임계값 이상은 불투명과 같다
+    long alpha_bad = 0;
+    for (int v = 0; v < 256; v += 5) {
+        for (int a = 0; a < 256; a++) {
+            uint8_t lut = epd_color_lut(v, 255 - v, v / 2, a);
+            if (lut != get_nearest_epd_color(v, 255 - v, v / 2, a)) {
+                if (a < EPD_ALPHA_THRESHOLD || lut != epd_color_lut(v, 255 - v, v / 2, 0xff)) {
+                    alpha_bad++;
+                }
+            }
+        }
+    }
+
+    const double total = 256.0 * 256.0 * 256.0;
+    double rate = mismatches / total;
+    printf("inputs     : %.0f (%d cells of %d^3)\n", total, EPD_LUT_CELLS, cell_side);
+    printf("mismatches : %ld (%.4f%%) in %ld boundary cells (%.2f%% of cells)\n",
+           mismatches, rate * 100.0, bad_cells, bad_cells * 100.0 / EPD_LUT_CELLS);
+    printf("worst      : LUT color %.2f farther than nearest at (%d, %d, %d), bound %.2f\n",
+           worst_excess, worst_rgb[0], worst_rgb[1], worst_rgb[2], MAX_DIST_EXCESS);
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            if (pairs[i][j]) {
+                printf("  lut %d / nearest %d : %ld\n", i, j, pairs[i][j]);
+            }
+        }
+    }
+    printf("alpha      : %ld mismatches\n", alpha_bad);
+
+    int fail = rate > MAX_MISMATCH_RATE || worst_excess > MAX_DIST_EXCESS || alpha_bad != 0;
+    printf("%s\n", fail ? "FAILED" : "ok");
+    return fail;
+}
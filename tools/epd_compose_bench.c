@@ -0,0 +1,121 @@
+/*
+ * epd_compose_bench.c
+ *
+ * 호스트용 벤치마크: 예전 epd_displaypart()의 이중 루프(바이트마다 범위 비교 4번 + 곱셈)와
+ * epd_compose의 행 구간 합성을 비교한다. 짝수 x는 두 결과가 같은지, 홀수 x는 픽셀 단위
+ * 기준 구현과 같은지도 확인한다.
+ *
+ *   cc -O2 -Imain tools/epd_compose_bench.c main/epd_compose.c -o epd_compose_bench
+ *   ./epd_compose_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "epd_compose.h"
+
+#define PANEL_W  400
+#define PANEL_H  600
+#define STRIDE   (PANEL_W / 2)
+#define ROUNDS   200
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// 예전 epd_displaypart() 루프 그대로
+static void legacy_compose(uint8_t *frame, const uint8_t *image, int xstart, int ystart, int image_width, int image_heigh)
+{
+    for (int i = 0; i < PANEL_H; i++) {
+        for (int j = 0; j < STRIDE; j++) {
+            size_t idx = i * STRIDE + j;
+            if ((i < (image_heigh + ystart)) && (i >= ystart) && (j < ((image_width + xstart) / 2)) && (j >= (xstart / 2))) {
+                frame[idx] = image[(j - xstart / 2) + (image_width / 2 * (i - ystart))];
+            } else {
+                frame[idx] = 0x11;
+            }
+        }
+    }
+}
+
+// 픽셀 단위 기준 구현 (홀수 x 검증용)
+static void reference_compose(uint8_t *frame, const uint8_t *image, int x, int y, int w, int h)
+{
+    int src_stride = (w + 1) / 2;
+    memset(frame, 0x11, STRIDE * PANEL_H);
+    for (int r = 0; r < h && y + r < PANEL_H; r++) {
+        for (int k = 0; k < w && x + k < PANEL_W; k++) {
+            uint8_t v = image[r * src_stride + k / 2];
+            v = (k & 1) ? (v & 0x0f) : (v >> 4);
+            uint8_t *d = &frame[(y + r) * STRIDE + (x + k) / 2];
+            *d = ((x + k) & 1) ? ((*d & 0xf0) | v) : ((*d & 0x0f) | (v << 4));
+        }
+    }
+}
+
+static void compose_frame(uint8_t *frame, const uint8_t *image, int x, int y, int w, int h)
+{
+    epd_compose_t c;
+    epd_compose_init(&c, image, w, h, x, y, PANEL_W, PANEL_H, 0x1);
+    epd_compose_fill(&c, frame, 0, STRIDE * PANEL_H);
+}
+
+int main(void)
+{
+    uint8_t *image = malloc(STRIDE * PANEL_H);
+    uint8_t *a = malloc(STRIDE * PANEL_H);
+    uint8_t *b = malloc(STRIDE * PANEL_H);
+    srand(1);
+    for (int i = 0; i < STRIDE * PANEL_H; i++) {
+        image[i] = rand();
+    }
+
+    // 검증
+    int bad = 0;
+    for (int t = 0; t < 5000; t++) {
+        int w = 2 + rand() % PANEL_W;
+        int h = 1 + rand() % PANEL_H;
+        int x = rand() % PANEL_W;
+        int y = rand() % PANEL_H;
+        compose_frame(b, image, x, y, w, h);
+        if (x % 2 == 0 && w % 2 == 0) {
+            legacy_compose(a, image, x, y, w, h);
+        } else {
+            reference_compose(a, image, x, y, w, h);
+        }
+        if (memcmp(a, b, STRIDE * PANEL_H) != 0) {
+            printf("mismatch: x=%d y=%d w=%d h=%d\n", x, y, w, h);
+            bad++;
+        }
+    }
+
+    // 시간: 200x200 배지, 전체 화면
+    static const int cases[][4] = {
+        {100, 150, 200, 200},
+        {0, 0, PANEL_W, PANEL_H},
+        {101, 150, 200, 200},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int x = cases[i][0], y = cases[i][1], w = cases[i][2], h = cases[i][3];
+        double t0 = now_ms();
+        for (int r = 0; r < ROUNDS; r++) {
+            legacy_compose(a, image, x, y, w, h);
+        }
+        double t1 = now_ms();
+        for (int r = 0; r < ROUNDS; r++) {
+            compose_frame(b, image, x, y, w, h);
+        }
+        double t2 = now_ms();
+        printf("x=%3d y=%3d %3dx%3d  legacy %.3f ms  spans %.3f ms  (x%.1f)\n", x, y, w, h,
+               (t1 - t0) / ROUNDS, (t2 - t1) / ROUNDS, (t1 - t0) / (t2 - t1));
+    }
+
+    free(image);
+    free(a);
+    free(b);
+    printf("%s\n", bad ? "FAILED" : "ok");
+    return bad != 0;
+}
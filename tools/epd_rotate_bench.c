@@ -0,0 +1,208 @@
+/*
+ * epd_rotate_bench.c
+ *
+ * 호스트용 벤치마크: 세로 원본을 패널 버퍼에 90도 돌려 쓰는 두 방식 비교
+ *   per-row : 예전 epd_pack_index_row() (원본 행마다 패널 행 600개에 니블 읽고-고쳐-쓰기)
+ *   strip   : epd_rotate (내부 RAM 띠에 전치해 모았다가 패널 행마다 memcpy)
+ *
+ * 결과가 같은지 확인하고, 패널 버퍼(PSRAM) 접근을 ESP32 PSRAM 캐시 모델
+ * (32 KB, 2-way, 32바이트 줄, LRU)에 흘려 캐시 미스 수를 센다. 띠 버퍼와 인덱스 행은
+ * 내부 RAM이라 캐시를 거치지 않으므로 세지 않는다. 호스트 시간은 참고용이다.
+ *
+ *   warm : 패널 버퍼만 캐시를 쓴다고 가정 (하한)
+ *   cold : 원본 행 사이에 PNG 디코더(inflate 창, 플래시 코드)가 캐시를 다 밀어낸다고 가정.
+ *          실제 기기는 둘 사이이며 캐시를 코드와 같이 쓰므로 cold 쪽에 가깝다.
+ *
+ *   cc -O2 -Imain tools/epd_rotate_bench.c main/epd_rotate.c -o epd_rotate_bench
+ *   ./epd_rotate_bench
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "epd_rotate.h"
+
+#define PANEL_W  400
+#define PANEL_H  600
+#define STRIDE   ((PANEL_W + 1) / 2)
+#define ROUNDS   50
+
+#define CACHE_LINE  32
+#define CACHE_WAYS  2
+#define CACHE_SETS  (32 * 1024 / CACHE_LINE / CACHE_WAYS)
+
+typedef struct {
+    long tag[CACHE_SETS][CACHE_WAYS];
+    unsigned age[CACHE_SETS][CACHE_WAYS];
+    unsigned clock;
+    long accesses, misses;
+} cache_t;
+
+// 내용만 비운다 (카운터 유지)
+static void cache_flush(cache_t *c)
+{
+    for (int s = 0; s < CACHE_SETS; s++) {
+        for (int w = 0; w < CACHE_WAYS; w++) {
+            c->tag[s][w] = -1;
+            c->age[s][w] = 0;
+        }
+    }
+}
+
+static void cache_reset(cache_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    cache_flush(c);
+}
+
+static void cache_touch(cache_t *c, size_t addr, size_t len)
+{
+    for (long line = addr / CACHE_LINE; line <= (long)((addr + len - 1) / CACHE_LINE); line++) {
+        int set = line % CACHE_SETS;
+        int victim = 0;
+        c->accesses++;
+        c->clock++;
+        for (int w = 0; w < CACHE_WAYS; w++) {
+            if (c->tag[set][w] == line) {
+                c->age[set][w] = c->clock;
+                goto hit;
+            }
+            if (c->age[set][w] < c->age[set][victim]) {
+                victim = w;
+            }
+        }
+        c->misses++;
+        c->tag[set][victim] = line;
+        c->age[set][victim] = c->clock;
+hit:
+        ;
+    }
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// 예전 epd_pack_index_row()의 Rotate 90 분기 그대로
+static void per_row_put(uint8_t *frame, const uint8_t *idx, int y)
+{
+    size_t col = y / 2;
+    for (int c = 0; c < PANEL_H; c++) {
+        size_t i = (size_t)(PANEL_H - 1 - c) * STRIDE + col;
+        if ((y & 1) == 0) {
+            frame[i] = (idx[c] << 4) | (frame[i] & 0x0F);
+        } else {
+            frame[i] = (frame[i] & 0xF0) | (idx[c] & 0x0F);
+        }
+    }
+}
+
+static void per_row_trace(cache_t *cache, bool cold)
+{
+    for (int y = 0; y < PANEL_W; y++) {
+        if (cold) {
+            cache_flush(cache);
+        }
+        for (int c = 0; c < PANEL_H; c++) {
+            cache_touch(cache, (size_t)(PANEL_H - 1 - c) * STRIDE + y / 2, 1);
+        }
+    }
+}
+
+// epd_rotate_flush()가 패널 버퍼에 쓰는 구간 (띠마다 방향을 바꾼다)
+static void strip_trace(cache_t *cache, int strip_rows, bool cold)
+{
+    for (int first = 0; first < PANEL_W; first += strip_rows) {
+        int rows = PANEL_W - first < strip_rows ? PANEL_W - first : strip_rows;
+        bool up = (first / strip_rows) & 1;
+        if (cold) {
+            cache_flush(cache);
+        }
+        for (int i = 0; i < PANEL_H; i++) {
+            int r = up ? PANEL_H - 1 - i : i;
+            cache_touch(cache, (size_t)r * STRIDE + first / 2, (rows + 1) / 2);
+        }
+    }
+}
+
+int main(void)
+{
+    uint8_t *src = malloc((size_t)PANEL_W * PANEL_H);   // 원본 행 y = 패널 열 y, 행마다 PANEL_H 인덱스
+    uint8_t *a = malloc((size_t)STRIDE * PANEL_H);
+    uint8_t *b = malloc((size_t)STRIDE * PANEL_H);
+    static const int strips[] = { 16, 32, 64 };
+    uint8_t *strip = malloc(epd_rotate_strip_size(PANEL_H, 64));
+    cache_t *cache = malloc(sizeof(cache_t));
+
+    srand(1);
+    for (size_t i = 0; i < (size_t)PANEL_W * PANEL_H; i++) {
+        src[i] = rand() % 7;
+    }
+
+    // 검증 + 캐시 모델 (예전 방식)
+    memset(a, 0x11, (size_t)STRIDE * PANEL_H);
+    for (int y = 0; y < PANEL_W; y++) {
+        per_row_put(a, src + (size_t)y * PANEL_H, y);
+    }
+    long warm, cold;
+    cache_reset(cache);
+    per_row_trace(cache, false);
+    warm = cache->misses;
+    cache_reset(cache);
+    per_row_trace(cache, true);
+    cold = cache->misses;
+    printf("per-row   : %7ld line accesses  misses warm %7ld  cold %7ld\n", cache->accesses, warm, cold);
+
+    int bad = 0;
+    for (size_t s = 0; s < sizeof(strips) / sizeof(strips[0]); s++) {
+        epd_rotate_t r;
+        memset(b, 0xEE, (size_t)STRIDE * PANEL_H);
+        epd_rotate_init(&r, b, PANEL_W, PANEL_H, strip, strips[s]);
+        for (int y = 0; y < PANEL_W; y++) {
+            epd_rotate_put(&r, src + (size_t)y * PANEL_H, y);
+        }
+        if (memcmp(a, b, (size_t)STRIDE * PANEL_H) != 0) {
+            printf("mismatch: strip %d\n", strips[s]);
+            bad++;
+        }
+        cache_reset(cache);
+        strip_trace(cache, strips[s], false);
+        warm = cache->misses;
+        cache_reset(cache);
+        strip_trace(cache, strips[s], true);
+        cold = cache->misses;
+        printf("strip %3d : %7ld line accesses  misses warm %7ld  cold %7ld  (strip %zu bytes)\n",
+               strips[s], cache->accesses, warm, cold, epd_rotate_strip_size(PANEL_H, strips[s]));
+    }
+
+    // 시간 (호스트)
+    double t0 = now_ms();
+    for (int k = 0; k < ROUNDS; k++) {
+        for (int y = 0; y < PANEL_W; y++) {
+            per_row_put(a, src + (size_t)y * PANEL_H, y);
+        }
+    }
+    double t1 = now_ms();
+    for (int k = 0; k < ROUNDS; k++) {
+        epd_rotate_t r;
+        epd_rotate_init(&r, b, PANEL_W, PANEL_H, strip, EPD_ROTATE_STRIP_ROWS);
+        for (int y = 0; y < PANEL_W; y++) {
+            epd_rotate_put(&r, src + (size_t)y * PANEL_H, y);
+        }
+    }
+    double t2 = now_ms();
+    printf("host time : per-row %.3f ms  strip %d %.3f ms\n", (t1 - t0) / ROUNDS,
+           EPD_ROTATE_STRIP_ROWS, (t2 - t1) / ROUNDS);
+
+    free(src);
+    free(a);
+    free(b);
+    free(strip);
+    free(cache);
+    printf("%s\n", bad ? "FAILED" : "ok");
+    return bad != 0;
+}
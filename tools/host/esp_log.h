@@ -0,0 +1,16 @@
+/*
+ * esp_log.h (호스트 빌드용)
+ *
+ * tools/의 호스트 프로그램이 main/의 .c 파일을 그대로 빌드할 수 있도록 로그 매크로만 둔다.
+ */
+#ifndef __HOST_ESP_LOG_H
+#define __HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...)  fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)  fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)  fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)  ((void)(tag))
+
+#endif